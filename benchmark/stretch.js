@@ -0,0 +1,61 @@
+// Times stretch on a synthetic radar-like image with the vectorized kernels
+// and then, in a child process, with GIFBLOBBER_NO_SIMD set.
+//
+//   node benchmark/stretch.js
+var child_process = require('child_process');
+var raw = require('../lib/index').raw;
+
+var width = 2000, height = 2000;
+var pixels = Buffer.alloc(width * height);
+for (var i = 0; i < pixels.length; i++) {
+  var x = i % width, y = (i / width) | 0;
+  pixels[i] = 7 + ((x * 13 + y * 7 + ((x * y) >> 6)) % 16);
+}
+var palette = Buffer.alloc(256 * 4);
+for (var i = 0; i < 256; i++) palette.writeUInt32LE((0x40000000 | i * 0x010203) >>> 0, i * 4);
+
+var cases = [
+  { name: 'zoom in 2048x2048', view: [500, 600, 500, 600], size: 2048, iterations: 10 },
+  { name: 'zoom in 256x256', view: [700, 712, 300, 312], size: 256, iterations: 400 },
+  { name: 'zoom out 2048x2048', view: [0, 2000, 0, 2000], size: 2048, iterations: 20 }
+];
+
+function time(testCase, callback) {
+  var dest = Buffer.alloc(testCase.size * testCase.size * 4);
+  var view = testCase.view;
+  var remaining = testCase.iterations;
+  var start = process.hrtime();
+  (function next() {
+    if (remaining-- == 0) {
+      var elapsed = process.hrtime(start);
+      return callback((elapsed[0] * 1e3 + elapsed[1] / 1e6) / testCase.iterations);
+    }
+    raw.stretch(pixels, width, height, palette, palette, view[0], view[1], view[2], view[3],
+                testCase.size, testCase.size, false, dest, next);
+  })();
+}
+
+function run(callback) {
+  var results = {};
+  (function next(i) {
+    if (i == cases.length) return callback(results);
+    time(cases[i], function(ms) {
+      results[cases[i].name] = ms;
+      next(i + 1);
+    });
+  })(0);
+}
+
+if (process.argv[2] == 'child') {
+  run(function(results) { console.log(JSON.stringify(results)); });
+} else {
+  run(function(simd) {
+    var env = Object.assign({}, process.env, { GIFBLOBBER_NO_SIMD: '1' });
+    var scalar = JSON.parse(child_process.execFileSync(process.execPath, [__filename, 'child'], { env: env }));
+    cases.forEach(function(testCase) {
+      var name = testCase.name;
+      console.log(name + ': ' + scalar[name].toFixed(2) + ' ms scalar, ' + simd[name].toFixed(2) +
+                  ' ms simd (' + (scalar[name] / simd[name]).toFixed(2) + 'x)');
+    });
+  });
+}
@@ -3,7 +3,7 @@
     {
       'target_name': 'node_gifblobber',
       'sources': [
-        'src/main.cc', 'src/slurp.cc', 'src/stretch.cc'
+        'src/main.cc', 'src/gif.cc', 'src/image.cc', 'src/kernels.cc', 'src/lzw.cc', 'src/mercator.cc', 'src/mipmap.cc', 'src/occupancy.cc', 'src/parallel.cc', 'src/png.cc', 'src/probe.cc', 'src/pyramid.cc', 'src/rle.cc', 'src/scan.cc', 'src/slurp.cc', 'src/stream.cc', 'src/stretch.cc'
       ],
       'dependencies': [
         'deps/giflib-5.0.0/binding.gyp:giflib'
@@ -0,0 +1,168 @@
+# This file is generated by gyp; do not edit.
+
+TOOLSET := target
+TARGET := giflib
+DEFS_Debug := \
+	'-DNODE_GYP_MODULE_NAME=giflib' \
+	'-DUSING_UV_SHARED=1' \
+	'-DUSING_V8_SHARED=1' \
+	'-DV8_DEPRECATION_WARNINGS=1' \
+	'-D_GLIBCXX_USE_CXX11_ABI=1' \
+	'-D_FILE_OFFSET_BITS=64' \
+	'-D_LARGEFILE_SOURCE' \
+	'-D__STDC_FORMAT_MACROS' \
+	'-DOPENSSL_NO_PINSHARED' \
+	'-DOPENSSL_THREADS' \
+	'-DDEBUG' \
+	'-D_DEBUG'
+
+# Flags passed to all source files.
+CFLAGS_Debug := \
+	-fPIC \
+	-pthread \
+	-Wall \
+	-Wextra \
+	-Wno-unused-parameter \
+	-Wno-sign-compare \
+	-m64 \
+	-g \
+	-O0
+
+# Flags passed to only C files.
+CFLAGS_C_Debug :=
+
+# Flags passed to only C++ files.
+CFLAGS_CC_Debug := \
+	-fno-rtti \
+	-fno-exceptions \
+	-std=gnu++17
+
+INCS_Debug := \
+	-I/tmp/nodedir/include/node \
+	-I/tmp/nodedir/src \
+	-I/tmp/nodedir/deps/openssl/config \
+	-I/tmp/nodedir/deps/openssl/openssl/include \
+	-I/tmp/nodedir/deps/uv/include \
+	-I/tmp/nodedir/deps/zlib \
+	-I/tmp/nodedir/deps/v8/include \
+	-I$(srcdir)/deps/giflib-5.0.0
+
+DEFS_Release := \
+	'-DNODE_GYP_MODULE_NAME=giflib' \
+	'-DUSING_UV_SHARED=1' \
+	'-DUSING_V8_SHARED=1' \
+	'-DV8_DEPRECATION_WARNINGS=1' \
+	'-D_GLIBCXX_USE_CXX11_ABI=1' \
+	'-D_FILE_OFFSET_BITS=64' \
+	'-D_LARGEFILE_SOURCE' \
+	'-D__STDC_FORMAT_MACROS' \
+	'-DOPENSSL_NO_PINSHARED' \
+	'-DOPENSSL_THREADS' \
+	'-DNDEBUG'
+
+# Flags passed to all source files.
+CFLAGS_Release := \
+	-fPIC \
+	-pthread \
+	-Wall \
+	-Wextra \
+	-Wno-unused-parameter \
+	-Wno-sign-compare \
+	-m64 \
+	-O3 \
+	-fno-omit-frame-pointer
+
+# Flags passed to only C files.
+CFLAGS_C_Release :=
+
+# Flags passed to only C++ files.
+CFLAGS_CC_Release := \
+	-fno-rtti \
+	-fno-exceptions \
+	-std=gnu++17
+
+INCS_Release := \
+	-I/tmp/nodedir/include/node \
+	-I/tmp/nodedir/src \
+	-I/tmp/nodedir/deps/openssl/config \
+	-I/tmp/nodedir/deps/openssl/openssl/include \
+	-I/tmp/nodedir/deps/uv/include \
+	-I/tmp/nodedir/deps/zlib \
+	-I/tmp/nodedir/deps/v8/include \
+	-I$(srcdir)/deps/giflib-5.0.0
+
+OBJS := \
+	$(obj).target/$(TARGET)/deps/giflib-5.0.0/dgif_lib.o \
+	$(obj).target/$(TARGET)/deps/giflib-5.0.0/egif_lib.o \
+	$(obj).target/$(TARGET)/deps/giflib-5.0.0/gif_err.o \
+	$(obj).target/$(TARGET)/deps/giflib-5.0.0/gif_hash.o \
+	$(obj).target/$(TARGET)/deps/giflib-5.0.0/gifalloc.o
+
+# Add to the list of files we specially track dependencies for.
+all_deps += $(OBJS)
+
+# CFLAGS et al overrides must be target-local.
+# See "Target-specific Variable Values" in the GNU Make manual.
+$(OBJS): TOOLSET := $(TOOLSET)
+$(OBJS): GYP_CFLAGS := $(DEFS_$(BUILDTYPE)) $(INCS_$(BUILDTYPE))  $(CFLAGS_$(BUILDTYPE)) $(CFLAGS_C_$(BUILDTYPE))
+$(OBJS): GYP_CXXFLAGS := $(DEFS_$(BUILDTYPE)) $(INCS_$(BUILDTYPE))  $(CFLAGS_$(BUILDTYPE)) $(CFLAGS_CC_$(BUILDTYPE))
+
+# Suffix rules, putting all outputs into $(obj).
+
+$(obj).$(TOOLSET)/$(TARGET)/%.o: $(srcdir)/%.c FORCE_DO_CMD
+	@$(call do_cmd,cc,1)
+
+# Try building from generated source, too.
+
+$(obj).$(TOOLSET)/$(TARGET)/%.o: $(obj).$(TOOLSET)/%.c FORCE_DO_CMD
+	@$(call do_cmd,cc,1)
+
+$(obj).$(TOOLSET)/$(TARGET)/%.o: $(obj)/%.c FORCE_DO_CMD
+	@$(call do_cmd,cc,1)
+
+# End of this set of suffix rules
+### Rules for final target.
+LDFLAGS_Debug := \
+	-pthread \
+	-rdynamic \
+	-m64
+
+LDFLAGS_Release := \
+	-pthread \
+	-rdynamic \
+	-m64
+
+LIBS :=
+
+$(obj).target/deps/giflib-5.0.0/giflib.a: GYP_LDFLAGS := $(LDFLAGS_$(BUILDTYPE))
+$(obj).target/deps/giflib-5.0.0/giflib.a: LIBS := $(LIBS)
+$(obj).target/deps/giflib-5.0.0/giflib.a: TOOLSET := $(TOOLSET)
+$(obj).target/deps/giflib-5.0.0/giflib.a: $(OBJS)
+	$(call create_archive,$@,$^)
+
+# Add target alias
+.PHONY: giflib
+giflib: $(obj).target/deps/giflib-5.0.0/giflib.a
+
+# Add target alias to "all" target.
+.PHONY: all
+all: giflib
+
+# Add target alias
+.PHONY: giflib
+giflib: $(builddir)/giflib.a
+
+# Copy this to the static library output path.
+$(builddir)/giflib.a: TOOLSET := $(TOOLSET)
+$(builddir)/giflib.a: $(obj).target/deps/giflib-5.0.0/giflib.a FORCE_DO_CMD
+	$(call do_cmd,copy)
+
+all_deps += $(builddir)/giflib.a
+# Short alias for building this static library.
+.PHONY: giflib.a
+giflib.a: $(obj).target/deps/giflib-5.0.0/giflib.a $(builddir)/giflib.a
+
+# Add static library to "all" target.
+.PHONY: all
+all: $(builddir)/giflib.a
+
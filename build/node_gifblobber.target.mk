@@ -0,0 +1,175 @@
+# This file is generated by gyp; do not edit.
+
+TOOLSET := target
+TARGET := node_gifblobber
+DEFS_Debug := \
+	'-DNODE_GYP_MODULE_NAME=node_gifblobber' \
+	'-DUSING_UV_SHARED=1' \
+	'-DUSING_V8_SHARED=1' \
+	'-DV8_DEPRECATION_WARNINGS=1' \
+	'-D_GLIBCXX_USE_CXX11_ABI=1' \
+	'-D_FILE_OFFSET_BITS=64' \
+	'-D_LARGEFILE_SOURCE' \
+	'-D__STDC_FORMAT_MACROS' \
+	'-DOPENSSL_NO_PINSHARED' \
+	'-DOPENSSL_THREADS' \
+	'-DBUILDING_NODE_EXTENSION' \
+	'-DDEBUG' \
+	'-D_DEBUG'
+
+# Flags passed to all source files.
+CFLAGS_Debug := \
+	-fPIC \
+	-pthread \
+	-Wall \
+	-Wextra \
+	-Wno-unused-parameter \
+	-m64 \
+	-g \
+	-O0
+
+# Flags passed to only C files.
+CFLAGS_C_Debug :=
+
+# Flags passed to only C++ files.
+CFLAGS_CC_Debug := \
+	-fno-rtti \
+	-fno-exceptions \
+	-std=gnu++17
+
+INCS_Debug := \
+	-I/tmp/nodedir/include/node \
+	-I/tmp/nodedir/src \
+	-I/tmp/nodedir/deps/openssl/config \
+	-I/tmp/nodedir/deps/openssl/openssl/include \
+	-I/tmp/nodedir/deps/uv/include \
+	-I/tmp/nodedir/deps/zlib \
+	-I/tmp/nodedir/deps/v8/include \
+	-I$(srcdir)/deps/giflib-5.0.0
+
+DEFS_Release := \
+	'-DNODE_GYP_MODULE_NAME=node_gifblobber' \
+	'-DUSING_UV_SHARED=1' \
+	'-DUSING_V8_SHARED=1' \
+	'-DV8_DEPRECATION_WARNINGS=1' \
+	'-D_GLIBCXX_USE_CXX11_ABI=1' \
+	'-D_FILE_OFFSET_BITS=64' \
+	'-D_LARGEFILE_SOURCE' \
+	'-D__STDC_FORMAT_MACROS' \
+	'-DOPENSSL_NO_PINSHARED' \
+	'-DOPENSSL_THREADS' \
+	'-DBUILDING_NODE_EXTENSION'
+
+# Flags passed to all source files.
+CFLAGS_Release := \
+	-fPIC \
+	-pthread \
+	-Wall \
+	-Wextra \
+	-Wno-unused-parameter \
+	-m64 \
+	-O3 \
+	-fno-omit-frame-pointer
+
+# Flags passed to only C files.
+CFLAGS_C_Release :=
+
+# Flags passed to only C++ files.
+CFLAGS_CC_Release := \
+	-fno-rtti \
+	-fno-exceptions \
+	-std=gnu++17
+
+INCS_Release := \
+	-I/tmp/nodedir/include/node \
+	-I/tmp/nodedir/src \
+	-I/tmp/nodedir/deps/openssl/config \
+	-I/tmp/nodedir/deps/openssl/openssl/include \
+	-I/tmp/nodedir/deps/uv/include \
+	-I/tmp/nodedir/deps/zlib \
+	-I/tmp/nodedir/deps/v8/include \
+	-I$(srcdir)/deps/giflib-5.0.0
+
+OBJS := \
+	$(obj).target/$(TARGET)/src/main.o \
+	$(obj).target/$(TARGET)/src/gif.o \
+	$(obj).target/$(TARGET)/src/image.o \
+	$(obj).target/$(TARGET)/src/kernels.o \
+	$(obj).target/$(TARGET)/src/lzw.o \
+	$(obj).target/$(TARGET)/src/mercator.o \
+	$(obj).target/$(TARGET)/src/mipmap.o \
+	$(obj).target/$(TARGET)/src/occupancy.o \
+	$(obj).target/$(TARGET)/src/parallel.o \
+	$(obj).target/$(TARGET)/src/png.o \
+	$(obj).target/$(TARGET)/src/probe.o \
+	$(obj).target/$(TARGET)/src/pyramid.o \
+	$(obj).target/$(TARGET)/src/rle.o \
+	$(obj).target/$(TARGET)/src/scan.o \
+	$(obj).target/$(TARGET)/src/slurp.o \
+	$(obj).target/$(TARGET)/src/stream.o \
+	$(obj).target/$(TARGET)/src/stretch.o
+
+# Add to the list of files we specially track dependencies for.
+all_deps += $(OBJS)
+
+# Make sure our dependencies are built before any of us.
+$(OBJS): | $(builddir)/giflib.a $(obj).target/deps/giflib-5.0.0/giflib.a
+
+# CFLAGS et al overrides must be target-local.
+# See "Target-specific Variable Values" in the GNU Make manual.
+$(OBJS): TOOLSET := $(TOOLSET)
+$(OBJS): GYP_CFLAGS := $(DEFS_$(BUILDTYPE)) $(INCS_$(BUILDTYPE))  $(CFLAGS_$(BUILDTYPE)) $(CFLAGS_C_$(BUILDTYPE))
+$(OBJS): GYP_CXXFLAGS := $(DEFS_$(BUILDTYPE)) $(INCS_$(BUILDTYPE))  $(CFLAGS_$(BUILDTYPE)) $(CFLAGS_CC_$(BUILDTYPE))
+
+# Suffix rules, putting all outputs into $(obj).
+
+$(obj).$(TOOLSET)/$(TARGET)/%.o: $(srcdir)/%.cc FORCE_DO_CMD
+	@$(call do_cmd,cxx,1)
+
+# Try building from generated source, too.
+
+$(obj).$(TOOLSET)/$(TARGET)/%.o: $(obj).$(TOOLSET)/%.cc FORCE_DO_CMD
+	@$(call do_cmd,cxx,1)
+
+$(obj).$(TOOLSET)/$(TARGET)/%.o: $(obj)/%.cc FORCE_DO_CMD
+	@$(call do_cmd,cxx,1)
+
+# End of this set of suffix rules
+### Rules for final target.
+LDFLAGS_Debug := \
+	-pthread \
+	-rdynamic \
+	-m64
+
+LDFLAGS_Release := \
+	-pthread \
+	-rdynamic \
+	-m64
+
+LIBS :=
+
+$(obj).target/node_gifblobber.node: GYP_LDFLAGS := $(LDFLAGS_$(BUILDTYPE))
+$(obj).target/node_gifblobber.node: LIBS := $(LIBS)
+$(obj).target/node_gifblobber.node: TOOLSET := $(TOOLSET)
+$(obj).target/node_gifblobber.node: $(OBJS) $(obj).target/deps/giflib-5.0.0/giflib.a FORCE_DO_CMD
+	$(call do_cmd,solink_module)
+
+all_deps += $(obj).target/node_gifblobber.node
+# Add target alias
+.PHONY: node_gifblobber
+node_gifblobber: $(builddir)/node_gifblobber.node
+
+# Copy this to the executable output path.
+$(builddir)/node_gifblobber.node: TOOLSET := $(TOOLSET)
+$(builddir)/node_gifblobber.node: $(obj).target/node_gifblobber.node FORCE_DO_CMD
+	$(call do_cmd,copy)
+
+all_deps += $(builddir)/node_gifblobber.node
+# Short alias for building this executable.
+.PHONY: node_gifblobber.node
+node_gifblobber.node: $(obj).target/node_gifblobber.node $(builddir)/node_gifblobber.node
+
+# Add executable to "all" target.
+.PHONY: all
+all: $(builddir)/node_gifblobber.node
+
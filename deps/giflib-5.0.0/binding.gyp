@@ -49,9 +49,13 @@
       },
       'defines': [
       ],
+      # egif_lib.c compares its int counts against unsigned sizes
+      'cflags': [ '-Wno-sign-compare' ],
       'sources': [ 
         './dgif_lib.c', 
+        './egif_lib.c',
         './gif_err.c',
+        './gif_hash.c',
         './gifalloc.c'
       ],
     },
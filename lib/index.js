@@ -16,17 +16,251 @@ BytePalettedImage.prototype.colorAt = function(x, y) {
   return this.palette.readUInt32LE(4 * this.pixels[x + y*this.width]);
 }
 
+// Calls cb(null, { covered, empty }) when done: how many of the pixels
+// written show, being not fully transparent, and whether none do. Pixels
+// outside the image are left alone and never count.
 BytePalettedImage.prototype.stretch = function(sourceLeft, sourceRight, sourceTop, sourceBottom, width, height, filtered, dest, cb) {
-  raw.stretch(this.pixels, this.width, this.height, this.unfiltered_palette, this.filtered_palette, sourceLeft, sourceRight, sourceTop, sourceBottom, width, height, !!filtered, dest, cb);
+  stretchImage(this, {}, sourceLeft, sourceRight, sourceTop, sourceBottom, width, height, filtered, dest, cb);
 }
 
+// The same, with options:
+//   latitudes - { north, south }: the source is on a latitude/longitude grid
+//               whose rows run from north down to south, and the output rows
+//               are evenly spaced in Web Mercator instead. Sources are still
+//               given in pixels.
+//   reduce - 'max' or 'mean' to zoom out by reducing every source pixel
+//            under an output pixel rather than sampling one ('nearest')
+//   mipmaps - false to always read the full-size image
+//   format - how pixels are written to dest: 'rgba' (the default), 'bgra'
+//            or 'premultiplied' (RGBA with the colors scaled by the alpha),
+//            4 bytes each; 'rgb565', 2 bytes in native order; or 'indexed',
+//            the palette index in 1 byte
+BytePalettedImage.prototype.stretchWith = function(options, sourceLeft, sourceRight, sourceTop, sourceBottom, width, height, filtered, dest, cb) {
+  stretchImage(this, options, sourceLeft, sourceRight, sourceTop, sourceBottom, width, height, filtered, dest, cb);
+}
+
+BytePalettedImage.prototype.stretchMercator = function(latitudes, sourceLeft, sourceRight, sourceTop, sourceBottom, width, height, filtered, dest, cb) {
+  this.stretchWith({ latitudes: latitudes }, sourceLeft, sourceRight, sourceTop, sourceBottom, width, height, filtered, dest, cb);
+}
+
+// The same stretch as an indexed PNG, cb(null, png, stats), in which pixels
+// outside the image are transparent. options are as for stretchWith, and
+// may be left out.
+BytePalettedImage.prototype.stretchToPng = function(options, sourceLeft, sourceRight, sourceTop, sourceBottom, width, height, filtered, cb) {
+  if (typeof options == 'number') {
+    return this.stretchToPng({}, options, sourceLeft, sourceRight, sourceTop, sourceBottom, width, height, filtered);
+  }
+  stretchImage(this, options, sourceLeft, sourceRight, sourceTop, sourceBottom, width, height, filtered, raw.stretchToPng, cb);
+}
+
+// The same as a GIF, cb(null, gif, stats). Translucent colors come out
+// opaque.
+BytePalettedImage.prototype.stretchToGif = function(options, sourceLeft, sourceRight, sourceTop, sourceBottom, width, height, filtered, cb) {
+  if (typeof options == 'number') {
+    return this.stretchToGif({}, options, sourceLeft, sourceRight, sourceTop, sourceBottom, width, height, filtered);
+  }
+  stretchImage(this, options, sourceLeft, sourceRight, sourceTop, sourceBottom, width, height, filtered, raw.stretchToGif, cb);
+}
+
+// Builds this.mipmaps: the image max-reduced to 1/2, 1/4, ... of its size,
+// each level { width, height, pixels }. From then on, stretches that shrink
+// the image at least twofold read the smallest level that still has as
+// many pixels as the output, which is max-preserving like reduce: 'max'.
+BytePalettedImage.prototype.buildMipmaps = function(callback) {
+  var self = this;
+  var done = function(err, levels) {
+    if (err) return callback(err);
+    self.mipmaps = levels;
+    return callback(null, self);
+  };
+  if (this.rowStarts) {
+    raw.buildMipmaps(this.runs, this.width, this.height, done, this.rowStarts);
+  } else {
+    raw.buildMipmaps(this.pixels, this.width, this.height, done);
+  }
+}
+
+// The same image kept as runs of equal pixels, row by row; see src/rle.h
+function RunLengthPalettedImage(width, height, runs, rowStarts, unfiltered_palette, filtered_palette) {
+  this.width = width;
+  this.height = height;
+  this.runs = runs;
+  this.rowStarts = rowStarts;
+  this.unfiltered_palette = unfiltered_palette;
+  this.filtered_palette = filtered_palette;
+}
+
+RunLengthPalettedImage.prototype.stretch = BytePalettedImage.prototype.stretch;
+RunLengthPalettedImage.prototype.stretchWith = BytePalettedImage.prototype.stretchWith;
+RunLengthPalettedImage.prototype.stretchMercator = BytePalettedImage.prototype.stretchMercator;
+RunLengthPalettedImage.prototype.stretchToPng = BytePalettedImage.prototype.stretchToPng;
+RunLengthPalettedImage.prototype.stretchToGif = BytePalettedImage.prototype.stretchToGif;
+RunLengthPalettedImage.prototype.buildMipmaps = BytePalettedImage.prototype.buildMipmaps;
+
+// Decoded images carry occupancy: which 16x16 blocks hold anything above
+// the blank-out levels, a byte each (see src/occupancy.h). Stretches use it
+// to fill blank stretches of the image without reading them.
+function withOccupancy(image, occupancy) {
+  image.occupancy = occupancy || null;
+  return image;
+}
+
+// The mipmap level, if any, worth stretching from instead of the image, and
+// how many image pixels each of its pixels spans. Averaging cannot be done
+// from maxima, so mean reductions always read the image.
+function pickMipmap(image, options, sourceWidth, sourceHeight, width, height) {
+  if (!image.mipmaps || options.mipmaps === false || options.reduce == 'mean') return null;
+  var shrink = Math.min(sourceWidth / width, sourceHeight / height);
+  var level = 0;
+  while (level < image.mipmaps.length && Math.pow(2, level + 1) <= shrink) level++;
+  if (level == 0) return null;
+  return { level: image.mipmaps[level - 1], scale: Math.pow(2, level) };
+}
+
+// Stretches into dest, or with an encoder (raw.stretchToPng or
+// raw.stretchToGif) in its place makes cb(null, file) instead
+function stretchImage(image, options, sourceLeft, sourceRight, sourceTop, sourceBottom, width, height, filtered, dest, cb) {
+  var latitudes = options.latitudes || null;
+  var reduce = options.reduce || null;
+  var format = options.format || null;
+  var mipmap = pickMipmap(image, options, Math.abs(sourceRight - sourceLeft), Math.abs(sourceBottom - sourceTop), width, height);
+  var source = image.rowStarts ? image.runs : image.pixels;
+  var sourceWidth = image.width, sourceHeight = image.height, rowStarts = image.rowStarts || null;
+  var occupancy = image.occupancy || null;
+
+  if (mipmap) {
+    var level = mipmap.level, scale = mipmap.scale;
+    if (latitudes) {
+      // A level's last row may reach past the image's
+      var span = (latitudes.south - latitudes.north) * level.height * scale / image.height;
+      latitudes = { north: latitudes.north, south: latitudes.north + span };
+    }
+    source = level.pixels;
+    sourceWidth = level.width;
+    sourceHeight = level.height;
+    rowStarts = null;
+    occupancy = null; // It maps the image, not the level
+    sourceLeft /= scale;
+    sourceRight /= scale;
+    sourceTop /= scale;
+    sourceBottom /= scale;
+  }
+
+  if (typeof dest == 'function') {
+    var encode = dest;
+    encode(source, sourceWidth, sourceHeight, image.unfiltered_palette, image.filtered_palette,
+           sourceLeft, sourceRight, sourceTop, sourceBottom, width, height, !!filtered, cb,
+           rowStarts, latitudes, reduce, occupancy);
+  } else if (rowStarts) {
+    raw.stretchRle(source, sourceWidth, sourceHeight, image.unfiltered_palette, image.filtered_palette,
+                   sourceLeft, sourceRight, sourceTop, sourceBottom, width, height, !!filtered, dest, cb,
+                   rowStarts, latitudes, reduce, format, occupancy);
+  } else {
+    raw.stretch(source, sourceWidth, sourceHeight, image.unfiltered_palette, image.filtered_palette,
+                sourceLeft, sourceRight, sourceTop, sourceBottom, width, height, !!filtered, dest, cb,
+                latitudes, reduce, format, occupancy);
+  }
+}
+
+function StreamDecoder(callback) {
+  this.handle = raw.createDecoder(function(err, width, height, pixels, unfiltered_palette, filtered_palette, occupancy) {
+    if (err) return callback(err);
+    return callback(null, withOccupancy(new BytePalettedImage(width, height, pixels, unfiltered_palette, filtered_palette), occupancy));
+  });
+}
+
+StreamDecoder.prototype.push = function(chunk) {
+  raw.decoderPush(this.handle, chunk);
+}
+
+StreamDecoder.prototype.end = function(chunk) {
+  if (chunk) this.push(chunk);
+  raw.decoderEnd(this.handle);
+}
+
+// options, if given, is { rows } or { left, top, right, bottom } to keep
+// only that part of the image. With rle: true the image comes back as
+// runs, which is far smaller when most of it is empty.
+function slurpWith(slurp, source, options, callback) {
+  if (typeof options == 'function') {
+    callback = options;
+    options = {};
+  }
+  slurp(source, options, function(err, width, height, pixels, unfiltered_palette, filtered_palette, occupancy, rowStarts) {
+    if (err) return callback(err);
+    if (options.rle) {
+      return callback(null, withOccupancy(new RunLengthPalettedImage(width, height, pixels, rowStarts, unfiltered_palette, filtered_palette), occupancy));
+    }
+    return callback(null, withOccupancy(new BytePalettedImage(width, height, pixels, unfiltered_palette, filtered_palette), occupancy));
+  });
+}
 
 module.exports = {
-  decode: function(buffer, callback) {
-    raw.slurp(buffer, function(err, width, height, pixels, unfiltered_palette, filtered_palette) {
+  decode: function(buffer, options, callback) {
+    slurpWith(raw.slurp, buffer, options, callback);
+  },
+  // The file is mapped and decoded on the worker, so its bytes never pass
+  // through the JS heap
+  decodeFile: function(path, options, callback) {
+    slurpWith(raw.slurpFile, path, options, callback);
+  },
+  // Decodes every buffer in one go. results[i] is an image, or the Error
+  // buffers[i] gave.
+  decodeMany: function(buffers, callback) {
+    raw.slurpMany(buffers, function(err, results) {
+      if (err) return callback(err);
+      return callback(null, results.map(function(result) {
+        if (result instanceof Error) return result;
+        return withOccupancy(new BytePalettedImage(result.width, result.height, result.pixels, result.unfiltered_palette, result.filtered_palette),
+                             result.occupancy);
+      }));
+    });
+  },
+  // Every frame composited onto the full canvas. The frames' pixels are views
+  // into one shared buffer.
+  decodeFrames: function(buffer, callback) {
+    raw.slurpFrames(buffer, function(err, width, height, frameCount, pixels, unfiltered_palette, filtered_palette, delays, occupancy) {
       if (err) return callback(err);
-      return callback(null, new BytePalettedImage(width, height, pixels, unfiltered_palette, filtered_palette));
+      var frames = [];
+      var frameSize = width * height;
+      var mapSize = occupancy.length / frameCount;
+      for (var i = 0; i < frameCount; i++) {
+        var image = new BytePalettedImage(width, height, pixels.slice(i*frameSize, (i+1)*frameSize), unfiltered_palette, filtered_palette);
+        withOccupancy(image, occupancy.slice(i*mapSize, (i+1)*mapSize));
+        image.delay = delays[i];
+        frames.push(image);
+      }
+      return callback(null, frames);
     });
   },
+  // Stretches image onto every tile of zoom levels [minZoom, maxZoom] it
+  // reaches into, the world being one tile at zoom 0 and bounds
+  // ({ left, top, right, bottom }, fractions of the world, all of it by
+  // default) being where the image lies. Tiles come to
+  // sink(null, [{ z, x, y, pixels, covered, empty }, ...]) in batches, and
+  // sink(null, null) follows the last. covered and empty are as for stretch,
+  // so empty tiles need not be stored or encoded. With latitudes ({ north, south }, see stretchMercator)
+  // the tiles are Web Mercator, and only bounds.left and right are used.
+  // reduce and format are as for stretchWith.
+  renderPyramid: function(image, options, sink) {
+    var bounds = options.bounds || { left: 0, top: 0, right: 1, bottom: 1 };
+    raw.renderPyramid(image.runs || image.pixels, image.width, image.height, image.unfiltered_palette, image.filtered_palette,
+                      !!options.filtered, options.minZoom || 0, options.maxZoom, options.tileSize || 256,
+                      bounds.left, bounds.top || 0, bounds.right, bounds.bottom || 1, sink,
+                      image.rowStarts || null, options.latitudes || null, options.reduce || null,
+                      options.format || null, image.occupancy || null);
+  },
+  probe: function(buffer) {
+    return raw.probe(buffer);
+  },
+  // Decodes a GIF pushed a chunk at a time, calling callback(err, image)
+  // once it has been ended. Each decoder runs on a thread of its own until
+  // then, so at most 64 may be running at once: past that createDecoder
+  // throws until some finish.
+  createDecoder: function(callback) {
+    return new StreamDecoder(callback);
+  },
+  BytePalettedImage: BytePalettedImage,
+  RunLengthPalettedImage: RunLengthPalettedImage,
   raw: raw,
 };
@@ -0,0 +1,126 @@
+#include "gif.h"
+#include <stdlib.h>
+#include <string.h>
+#include <gif_lib.h>
+
+// Where EGif writes the file: a buffer that grows as needed
+struct gif_sink {
+  unsigned char *data;
+  size_t length;
+  size_t capacity;
+  bool out_of_memory;
+};
+
+static int write_to_sink(GifFileType *gif_file, const GifByteType *bytes, int count) {
+  gif_sink *sink = (gif_sink *)gif_file->UserData;
+  if (sink->out_of_memory) return 0;
+  if (sink->length + count > sink->capacity) {
+    size_t capacity = sink->capacity * 2 > sink->length + count ? sink->capacity * 2 : sink->length + count;
+    unsigned char *data = (unsigned char *)realloc(sink->data, capacity);
+    if (!data) {
+      sink->out_of_memory = true;
+      return 0;
+    }
+    sink->data = data;
+    sink->capacity = capacity;
+  }
+  memcpy(sink->data + sink->length, bytes, count);
+  sink->length += count;
+  return count;
+}
+
+/*
+ * The smallest rectangle holding every pixel that is not transparent, or
+ * an empty one at the origin if there are none
+ */
+static void opaque_bounds(const unsigned char *indices, int width, int height, int transparent,
+                          int *left, int *top, int *right, int *bottom) {
+  *left = width;
+  *top = height;
+  *right = 0;
+  *bottom = 0;
+  for (int y = 0; y < height; y++) {
+    const unsigned char *row = indices + (size_t)width * y;
+    int x = 0;
+    while (x < width && row[x] == transparent) x++;
+    if (x == width) continue;
+    int last = width - 1;
+    while (row[last] == transparent) last--;
+    if (x < *left) *left = x;
+    if (last + 1 > *right) *right = last + 1;
+    if (*top == height) *top = y;
+    *bottom = y + 1;
+  }
+  if (*right <= *left) *left = *top = *right = *bottom = 0;
+}
+
+unsigned char *encode_indexed_gif(unsigned char *indices, int width, int height,
+                                  const uint8_t *palette, int palette_size, int transparent,
+                                  size_t *length) {
+  // The color table must have a power of two entries, at least two
+  int bits = 1;
+  while ((1 << bits) < palette_size) bits++;
+  GifColorType colors[256];
+  memset(colors, 0, sizeof(colors));
+  for (int i = 0; i < palette_size; i++) {
+    colors[i].Red = palette[4*i];
+    colors[i].Green = palette[4*i + 1];
+    colors[i].Blue = palette[4*i + 2];
+  }
+  ColorMapObject *color_map = GifMakeMapObject(1 << bits, colors);
+  if (!color_map) return nullptr;
+
+  // Transparent pixels around the edges are left to the background rather
+  // than encoded. A GIF still needs one image, so with nothing else there
+  // it is a single transparent pixel.
+  int left = 0, top = 0, right = width, bottom = height;
+  if (transparent >= 0) {
+    opaque_bounds(indices, width, height, transparent, &left, &top, &right, &bottom);
+    if (right == 0) right = bottom = 1;
+  }
+
+  gif_sink sink = { nullptr, 0, 0, false };
+  int gif_error;
+  GifFileType *gif_file = EGifOpen(&sink, write_to_sink, &gif_error);
+  if (!gif_file) {
+    GifFreeMapObject(color_map);
+    return nullptr;
+  }
+
+  GifByteType control[4];
+  GraphicsControlBlock control_block;
+  control_block.DisposalMode = DISPOSAL_UNSPECIFIED;
+  control_block.UserInputFlag = false;
+  control_block.DelayTime = 0;
+  control_block.TransparentColor = transparent >= 0 ? transparent : NO_TRANSPARENT_COLOR;
+  EGifGCBToExtension(&control_block, control);
+
+  // EGif stamps the file GIF89a only if it sees a GIF89 extension among
+  // the file's, so the control block is listed there while the header is
+  // written
+  ExtensionBlock control_extension = { sizeof(control), control, GRAPHICS_EXT_FUNC_CODE };
+  gif_file->ExtensionBlockCount = 1;
+  gif_file->ExtensionBlocks = &control_extension;
+  int result = EGifPutScreenDesc(gif_file, width, height, bits, transparent >= 0 ? transparent : 0, color_map);
+  gif_file->ExtensionBlockCount = 0;
+  gif_file->ExtensionBlocks = nullptr;
+
+  if (result != GIF_ERROR) {
+    result = EGifPutExtension(gif_file, GRAPHICS_EXT_FUNC_CODE, sizeof(control), control);
+  }
+  if (result != GIF_ERROR) {
+    result = EGifPutImageDesc(gif_file, left, top, right - left, bottom - top, false, nullptr);
+  }
+  for (int y = top; y < bottom && result != GIF_ERROR; y++) {
+    result = EGifPutLine(gif_file, indices + (size_t)width * y + left, right - left);
+  }
+  if (EGifCloseFile(gif_file) == GIF_ERROR) result = GIF_ERROR;
+  GifFreeMapObject(color_map);
+
+  if (result == GIF_ERROR || sink.out_of_memory) {
+    free(sink.data);
+    return nullptr;
+  }
+  *length = sink.length;
+  return sink.data;
+}
@@ -0,0 +1,21 @@
+#ifndef NODE_GIFBLOBBER_SRC_GIF_H
+#define NODE_GIFBLOBBER_SRC_GIF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Encodes width*height palette indices as a GIF89a, with the first
+ * palette_size entries of palette (R, G, B, A bytes per entry; alpha is
+ * dropped) as its global color table. Index transparent, if not -1, is
+ * made transparent and is also the background, and only the smallest
+ * rectangle holding every other index is LZW-encoded. EGif may rewrite
+ * indices in place as it goes.
+ * Returns the malloc'd file and sets *length, or returns nullptr if
+ * memory ran out.
+ */
+unsigned char *encode_indexed_gif(unsigned char *indices, int width, int height,
+                                  const uint8_t *palette, int palette_size, int transparent,
+                                  size_t *length);
+
+#endif
@@ -0,0 +1,712 @@
+#include "image.h"
+#include "lzw.h"
+#include "occupancy.h"
+#include "parallel.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+static inline int clamp(int inclusive_min, int x, int inclusive_max) {
+  return x <= inclusive_min ? inclusive_min
+       : x >= inclusive_max ? inclusive_max
+       : x;
+}
+
+static inline int gif_error(GifFileType *gif_file) {
+  // Some decoder failures return GIF_ERROR without recording why
+  return gif_file->Error ? gif_file->Error : D_GIF_ERR_IMAGE_DEFECT;
+}
+
+/*
+ * Copies the first stored_rows rows of a frame, decoded in stored row order,
+ * onto a canvas covering the window of the screen, undoing any interlacing.
+ * Anything falling outside the window is dropped, as are pixels of the
+ * transparent color if there is one.
+ */
+static void blit_frame(unsigned char *canvas, const image_region &window,
+                       int left, int top, int width, int height, bool interlace,
+                       int transparent_color, const unsigned char *frame, int stored_rows) {
+  static const int interlaced_offsets[] = { 0, 4, 2, 1 };
+  static const int interlaced_jumps[] = { 8, 8, 4, 2 };
+  int passes = interlace ? 4 : 1;
+  int canvas_width = window.right - window.left;
+  int first_x = clamp(left, window.left, left + width);
+  int visible_width = clamp(0, window.right - first_x, left + width - first_x);
+  const unsigned char *row = frame + (first_x - left);
+  int stored = 0;
+
+  for (int pass = 0; pass < passes; pass++) {
+    int first = interlace ? interlaced_offsets[pass] : 0;
+    int jump = interlace ? interlaced_jumps[pass] : 1;
+
+    for (int y = first; y < height; y += jump, row += width) {
+      if (stored++ == stored_rows) return;
+
+      int canvas_y = top + y;
+      if (canvas_y < window.top || canvas_y >= window.bottom) continue;
+
+      unsigned char *dest = canvas + (size_t)(canvas_y - window.top)*canvas_width + (first_x - window.left);
+      if (transparent_color == NO_TRANSPARENT_COLOR) {
+        memcpy(dest, row, visible_width);
+      } else {
+        for (int x = 0; x < visible_width; x++) {
+          if (row[x] != transparent_color) dest[x] = row[x];
+        }
+      }
+    }
+  }
+}
+
+/*
+ * How many of a frame's rows, in stored order, have to be decoded before
+ * every one of its rows that falls inside the window is available.
+ */
+static int stored_rows_needed(const image_region &window, int top, int height, bool interlace) {
+  static const int interlaced_offsets[] = { 0, 4, 2, 1 };
+  static const int interlaced_jumps[] = { 8, 8, 4, 2 };
+  int first = clamp(0, window.top - top, height);
+  int last = clamp(0, window.bottom - top, height); // Exclusive
+  if (first >= last) return 0;
+  if (!interlace) return last;
+
+  int needed = 0;
+  int stored = 0;
+  for (int pass = 0; pass < 4; pass++) {
+    for (int y = interlaced_offsets[pass]; y < height; y += interlaced_jumps[pass]) {
+      stored++;
+      if (y >= first && y < last) needed = stored;
+    }
+  }
+  return needed;
+}
+
+static inline image_region whole_screen(int screen_width, int screen_height) {
+  image_region window = { 0, 0, screen_width, screen_height };
+  return window;
+}
+
+/*
+ * Whether the frame's rows, as stored, are whole rows of the canvas so it
+ * can be decoded straight into it.
+ */
+static inline bool frame_is_canvas_rows(const image_region &window,
+                                        int left, int top, int width, int height, bool interlace) {
+  return !interlace && left == window.left && width == window.right - window.left
+      && top >= window.top && top + height <= window.bottom;
+}
+
+static unsigned char *allocate_canvas(const image_region &window, int left, int top,
+                                      int width, int height, int background) {
+  size_t pixel_count = (size_t)(window.right - window.left) * (window.bottom - window.top);
+  unsigned char *canvas = (unsigned char *)malloc(pixel_count ? pixel_count : 1);
+  if (canvas && (left > window.left || top > window.top
+              || left + width < window.right || top + height < window.bottom)) {
+    memset(canvas, background, pixel_count);
+  }
+  return canvas;
+}
+
+static void build_palettes(decoded_image *image, const GifColorType *colors, int color_count) {
+  memset(image->unfiltered_palette, 0, sizeof(image->unfiltered_palette));
+  memset(image->filtered_palette, 0, sizeof(image->filtered_palette));
+
+  int count = clamp(0, color_count, 256);
+
+  for (int i = 0; i < count; i++) {
+    GifColorType color = colors[i];
+    int alphaed = color.Red | (color.Green<<8) | (color.Blue<<16) | 0x40000000;
+    image->unfiltered_palette[i] = i <= UNFILTERED_BLANK_OUT_UNTIL ? 0 : alphaed;
+    image->filtered_palette[i] = i <= FILTERED_BLANK_OUT_UNTIL ? 0 : alphaed;
+  }
+}
+
+// Returns a giflib error code, or 0
+static int allocate_occupancy(decoded_image *image) {
+  size_t frame_size = occupancy_size(image->width, image->height);
+  image->occupancy = (unsigned char *)malloc(frame_size * image->frame_count + 1);
+  return image->occupancy ? 0 : D_GIF_ERR_NOT_ENOUGH_MEM;
+}
+
+/*
+ * Maps which blocks of each of the image's frames hold anything that can
+ * show, for decodes that could not map them as the rows came in from the
+ * top: interlaced or blitted frames, and composited ones. Returns a giflib
+ * error code, or 0.
+ */
+static int map_occupancy(decoded_image *image) {
+  int error = allocate_occupancy(image);
+  if (error) return error;
+
+  size_t frame_size = occupancy_size(image->width, image->height);
+  size_t canvas_size = (size_t)image->width * image->height;
+  parallel_for(image->frame_count, [image, frame_size, canvas_size](int i) {
+    build_occupancy(image->pixels + canvas_size * i, image->width, image->height, image->occupancy + frame_size * i);
+  });
+  return 0;
+}
+
+/*
+ * Decompresses the data sub-blocks of the image whose descriptor was just
+ * read into frame, in the order the rows are stored. Whatever follows the
+ * last needed pixel is skipped. Given an occupancy builder, frame is top
+ * rows down the raster it maps, as for decode_frame_rows. Returns a giflib
+ * error code, or 0.
+ */
+static int decompress_image(GifFileType *gif_file, unsigned char *frame, size_t pixel_count,
+                            occupancy_builder *occupancy, int top) {
+  int code_size;
+  GifByteType *block;
+
+  if (DGifGetCode(gif_file, &code_size, &block) == GIF_ERROR) {
+    return gif_error(gif_file);
+  }
+
+  lzw_decoder *decoder = new lzw_decoder;
+  lzw_init(decoder, code_size, frame, pixel_count);
+
+  int error = 0;
+  while (block != nullptr && !decoder->finished) {
+    error = lzw_decode(decoder, block + 1, block[0]);
+    if (error) break;
+    if (occupancy) occupancy_rows_ready(occupancy, top + (int)(decoder->position / occupancy->width));
+    if (DGifGetCodeNext(gif_file, &block) == GIF_ERROR) {
+      error = gif_error(gif_file);
+      break;
+    }
+  }
+  if (!error && !decoder->finished) {
+    // The sub-blocks ran out before the image was complete
+    error = D_GIF_ERR_IMAGE_DEFECT;
+  }
+  delete decoder;
+
+  while (!error && block != nullptr) {
+    if (DGifGetCodeNext(gif_file, &block) == GIF_ERROR) {
+      error = gif_error(gif_file);
+    }
+  }
+
+  return error;
+}
+
+/*
+ * Decodes the image whose descriptor was just read straight into canvas,
+ * which is screen-sized, mapping its occupancy as it goes where the rows
+ * come in order. Returns a giflib error code, or 0.
+ */
+static int read_image(GifFileType *gif_file, unsigned char *canvas, decoded_image *image) {
+  const GifImageDesc &desc = gif_file->Image;
+  int screen_width = gif_file->SWidth;
+  int screen_height = gif_file->SHeight;
+
+  if (desc.Width <= 0 || desc.Height <= 0) return 0;
+
+  size_t pixel_count = (size_t)desc.Width * desc.Height;
+  image_region screen = whole_screen(screen_width, screen_height);
+
+  if (frame_is_canvas_rows(screen, desc.Left, desc.Top, desc.Width, desc.Height, desc.Interlace)) {
+    // Rows are contiguous in the canvas, so decode right into it
+    int error = allocate_occupancy(image);
+    if (error) return error;
+    occupancy_builder occupancy;
+    occupancy_begin(&occupancy, canvas, screen_width, screen_height, image->occupancy);
+    error = decompress_image(gif_file, canvas + desc.Top*screen_width, pixel_count, &occupancy, desc.Top);
+    occupancy_rows_ready(&occupancy, screen_height);
+    return error;
+  }
+
+  unsigned char *frame = (unsigned char *)malloc(pixel_count);
+  if (!frame) return D_GIF_ERR_NOT_ENOUGH_MEM;
+
+  int error = decompress_image(gif_file, frame, pixel_count, nullptr, 0);
+  if (!error) {
+    blit_frame(canvas, screen, desc.Left, desc.Top, desc.Width, desc.Height, desc.Interlace,
+               NO_TRANSPARENT_COLOR, frame, desc.Height);
+  }
+
+  free(frame);
+  return error;
+}
+
+int read_first_image(GifFileType *gif_file, decoded_image *image) {
+  GifRecordType record_type;
+  GifByteType *extension;
+  int extension_code;
+
+  image->width = gif_file->SWidth;
+  image->frame_count = 1;
+  image->height = gif_file->SHeight;
+  image->pixels = nullptr;
+  image->occupancy = nullptr;
+  if (gif_file->SColorMap) {
+    build_palettes(image, gif_file->SColorMap->Colors, gif_file->SColorMap->ColorCount);
+  } else {
+    build_palettes(image, nullptr, 0);
+  }
+
+  do {
+    if (DGifGetRecordType(gif_file, &record_type) == GIF_ERROR) {
+      return gif_error(gif_file);
+    }
+
+    switch (record_type) {
+    case IMAGE_DESC_RECORD_TYPE: {
+      if (DGifGetImageDesc(gif_file) == GIF_ERROR) {
+        return gif_error(gif_file);
+      }
+
+      const GifImageDesc &desc = gif_file->Image;
+      unsigned char *pixels = allocate_canvas(whole_screen(gif_file->SWidth, gif_file->SHeight),
+          desc.Left, desc.Top, desc.Width, desc.Height, gif_file->SBackGroundColor);
+      if (!pixels) return D_GIF_ERR_NOT_ENOUGH_MEM;
+
+      int error = read_image(gif_file, pixels, image);
+      if (error) {
+        free(pixels);
+        free(image->occupancy);
+        image->occupancy = nullptr;
+        return error;
+      }
+
+      image->pixels = pixels;
+      return image->occupancy ? 0 : map_occupancy(image);
+    }
+
+    case EXTENSION_RECORD_TYPE:
+      if (DGifGetExtension(gif_file, &extension_code, &extension) == GIF_ERROR) {
+        return gif_error(gif_file);
+      }
+      while (extension != nullptr) {
+        if (DGifGetExtensionNext(gif_file, &extension) == GIF_ERROR) {
+          return gif_error(gif_file);
+        }
+      }
+      break;
+
+    default:
+      break;
+    }
+  } while (record_type != TERMINATE_RECORD_TYPE);
+
+  return D_GIF_ERR_NO_IMAG_DSCR;
+}
+
+/*
+ * Decoder state is large enough that batch and multi-frame decodes notice
+ * allocating it per image, so each thread keeps one around.
+ */
+static lzw_decoder *thread_decoder() {
+  static thread_local lzw_decoder decoder;
+  return &decoder;
+}
+
+// Bytes of codes decoded between looks for bands of rows that are out
+#define DECODE_PIECE 4096
+
+int decode_frame_rows(const unsigned char *gif, const gif_frame &frame, int stored_rows, unsigned char *pixels,
+                      occupancy_builder *occupancy, int top) {
+  size_t pixel_count = (size_t)frame.width * stored_rows;
+  if (pixel_count == 0) return 0;
+
+  // Stripping the sub-block framing up front lets the decoder run over the
+  // whole code stream in one go, refilling its bit buffer a word at a time
+  unsigned char *codes = (unsigned char *)malloc(frame.code_length ? frame.code_length : 1);
+  lzw_decoder *decoder = thread_decoder();
+  int error = 0;
+
+  if (!codes) {
+    error = D_GIF_ERR_NOT_ENOUGH_MEM;
+  } else {
+    gather_codes(gif, frame, codes);
+    lzw_init(decoder, frame.min_code_size, pixels, pixel_count);
+    if (!occupancy) {
+      error = lzw_decode(decoder, codes, frame.code_length);
+    } else {
+      for (size_t fed = 0; !error && !decoder->finished && fed < frame.code_length; fed += DECODE_PIECE) {
+        size_t piece = frame.code_length - fed < DECODE_PIECE ? frame.code_length - fed : DECODE_PIECE;
+        error = lzw_decode(decoder, codes + fed, piece);
+        occupancy_rows_ready(occupancy, top + (int)(decoder->position / frame.width));
+      }
+    }
+    if (!error && !decoder->finished) {
+      error = D_GIF_ERR_IMAGE_DEFECT;
+    }
+  }
+
+  free(codes);
+  return error;
+}
+
+int decode_frame(const unsigned char *gif, const gif_frame &frame, unsigned char *pixels) {
+  return decode_frame_rows(gif, frame, frame.height, pixels, nullptr, 0);
+}
+
+int decode_first_image(const unsigned char *gif, size_t length, const image_region *region, decoded_image *image) {
+  gif_info info;
+  image->pixels = nullptr;
+  image->occupancy = nullptr;
+
+  int error = scan_gif(gif, length, 1, &info);
+  if (error) return error;
+
+  image_region window = whole_screen(info.width, info.height);
+  if (region) {
+    window.left = clamp(0, region->left, info.width);
+    window.top = clamp(0, region->top, info.height);
+    window.right = clamp(window.left, region->right, info.width);
+    window.bottom = clamp(window.top, region->bottom, info.height);
+  }
+
+  const gif_frame &frame = info.frames[0];
+  image->width = window.right - window.left;
+  image->height = window.bottom - window.top;
+  image->frame_count = 1;
+  build_palettes(image, info.color_map, info.color_count);
+
+  unsigned char *pixels = allocate_canvas(window,
+      frame.left, frame.top, frame.width, frame.height, info.background);
+  if (!pixels) return D_GIF_ERR_NOT_ENOUGH_MEM;
+
+  // Rows past the last one the window needs are never decompressed. Columns
+  // outside it still have to be, since later codes refer back to them.
+  int stored_rows = stored_rows_needed(window, frame.top, frame.height, frame.interlace);
+  bool overlaps = frame.left < window.right && frame.left + frame.width > window.left;
+
+  if (!overlaps || stored_rows == 0) {
+    // Nothing of the frame shows through the window
+  } else if (frame_is_canvas_rows(window, frame.left, frame.top, frame.width, stored_rows, frame.interlace)) {
+    // The rows come in order, so each band is mapped while still in cache
+    error = allocate_occupancy(image);
+    if (!error) {
+      int top = frame.top - window.top;
+      occupancy_builder occupancy;
+      occupancy_begin(&occupancy, pixels, image->width, image->height, image->occupancy);
+      error = decode_frame_rows(gif, frame, stored_rows, pixels + (size_t)top*image->width, &occupancy, top);
+      occupancy_rows_ready(&occupancy, image->height);
+    }
+  } else {
+    unsigned char *frame_pixels = (unsigned char *)malloc((size_t)frame.width * stored_rows + 1);
+    if (!frame_pixels) {
+      error = D_GIF_ERR_NOT_ENOUGH_MEM;
+    } else {
+      error = decode_frame_rows(gif, frame, stored_rows, frame_pixels, nullptr, 0);
+      if (!error) {
+        blit_frame(pixels, window, frame.left, frame.top, frame.width, frame.height,
+                   frame.interlace, NO_TRANSPARENT_COLOR, frame_pixels, stored_rows);
+      }
+      free(frame_pixels);
+    }
+  }
+
+  if (error) {
+    free(pixels);
+    free(image->occupancy);
+    image->occupancy = nullptr;
+    return error;
+  }
+
+  image->pixels = pixels;
+  return image->occupancy ? 0 : map_occupancy(image);
+}
+
+/*
+ * Applies a frame's disposal method to the canvas it was drawn over, giving
+ * what the next frame is drawn onto.
+ */
+static void dispose_frame(unsigned char *canvas, int screen_width, int screen_height,
+                          const gif_frame &frame, int background) {
+  int fill = frame.transparent_color != NO_TRANSPARENT_COLOR ? frame.transparent_color : background;
+  int visible_width = clamp(0, screen_width - frame.left, frame.width);
+  int bottom = clamp(0, frame.top + frame.height, screen_height);
+
+  for (int y = frame.top; y < bottom; y++) {
+    memset(canvas + (size_t)y*screen_width + frame.left, fill, visible_width);
+  }
+}
+
+int decode_all_frames(const unsigned char *gif, size_t length, decoded_image *image) {
+  gif_info info;
+  image->pixels = nullptr;
+  image->occupancy = nullptr;
+  image->delays.clear();
+
+  int error = scan_gif(gif, length, INT_MAX, &info);
+  if (error) return error;
+
+  size_t canvas_size = (size_t)info.width * info.height;
+  image_region screen = whole_screen(info.width, info.height);
+  int frame_count = (int)info.frames.size();
+  image->width = info.width;
+  image->height = info.height;
+  image->frame_count = frame_count;
+  build_palettes(image, info.color_map, info.color_count);
+
+  // Each frame is its own LZW stream, so they are all decompressed at once
+  // into their own stretch of frame_pixels and only composited afterwards
+  std::vector<size_t> frame_offsets(frame_count + 1, 0);
+  for (int i = 0; i < frame_count; i++) {
+    frame_offsets[i + 1] = frame_offsets[i] + (size_t)info.frames[i].width * info.frames[i].height;
+  }
+  std::vector<int> frame_errors(frame_count, 0);
+
+  // Every composited frame lives in the one allocation handed to JS. The
+  // scratch canvas holds whatever the next frame is drawn over when that is
+  // not simply the previous frame as output.
+  unsigned char *pixels = (unsigned char *)malloc(canvas_size * frame_count + 1);
+  unsigned char *scratch = (unsigned char *)malloc(canvas_size + 1);
+  unsigned char *frame_pixels = (unsigned char *)malloc(frame_offsets[frame_count] + 1);
+  if (!pixels || !scratch || !frame_pixels) {
+    error = D_GIF_ERR_NOT_ENOUGH_MEM;
+    goto out;
+  }
+
+  parallel_for(frame_count, [&](int i) {
+    frame_errors[i] = decode_frame(gif, info.frames[i], frame_pixels + frame_offsets[i]);
+  });
+
+  for (int i = 0; i < frame_count && !error; i++) {
+    error = frame_errors[i];
+  }
+  if (error) goto out;
+
+  {
+    const unsigned char *previous = scratch;
+    memset(scratch, info.background, canvas_size);
+
+    for (int i = 0; i < frame_count; i++) {
+      const gif_frame &frame = info.frames[i];
+      unsigned char *canvas = pixels + canvas_size * i;
+
+      memcpy(canvas, previous, canvas_size);
+      blit_frame(canvas, screen, frame.left, frame.top, frame.width, frame.height, frame.interlace,
+                 frame.transparent_color, frame_pixels + frame_offsets[i], frame.height);
+      image->delays.push_back(frame.delay);
+
+      switch (frame.disposal) {
+      case DISPOSE_PREVIOUS:
+        break;
+      case DISPOSE_BACKGROUND:
+        memcpy(scratch, canvas, canvas_size);
+        dispose_frame(scratch, info.width, info.height, frame, info.background);
+        previous = scratch;
+        break;
+      default:
+        previous = canvas;
+        break;
+      }
+    }
+  }
+
+out:
+  free(frame_pixels);
+  free(scratch);
+  if (error) {
+    free(pixels);
+    image->delays.clear();
+    return error;
+  }
+
+  image->pixels = pixels;
+  return map_occupancy(image);
+}
+
+void free_image(decoded_image *image) {
+  free(image->pixels);
+  free(image->occupancy);
+  image->pixels = nullptr;
+  image->occupancy = nullptr;
+}
+
+static void free_pixels(napi_env env, void *data, void *hint) {
+  free(data);
+}
+
+napi_status create_gif_error(napi_env env, int error, napi_value *result) {
+  const char *message = GifErrorString(error);
+  napi_value message_string;
+  napi_status status = napi_create_string_utf8(env, message ? message : "Unknown GIF error", NAPI_AUTO_LENGTH, &message_string);
+  if (status != napi_ok) return status;
+  return napi_create_error(env, nullptr, message_string, result);
+}
+
+napi_status create_owned_buffer(napi_env env, void **data, size_t size, napi_value *buffer) {
+  void *buffer_data;
+  napi_status status = napi_create_external_buffer(env, size, *data, free_pixels, nullptr, buffer);
+  if (status == napi_no_external_buffers_allowed) {
+    return napi_create_buffer_copy(env, size, *data, &buffer_data, buffer);
+  }
+  if (status == napi_ok) *data = nullptr;
+  return status;
+}
+
+static napi_status create_palette_buffers(napi_env env, decoded_image *image,
+                                          napi_value *unfiltered_palette_buffer, napi_value *filtered_palette_buffer) {
+  void *buffer_data;
+  napi_status status = napi_create_buffer_copy(env, 256*4, image->unfiltered_palette, &buffer_data, unfiltered_palette_buffer);
+  if (status != napi_ok) return status;
+
+  return napi_create_buffer_copy(env, 256*4, image->filtered_palette, &buffer_data, filtered_palette_buffer);
+}
+
+/*
+ * Wraps the pixels and palettes of a decoded image in buffers, with the
+ * pixels' ownership passing to JS.
+ */
+static napi_status create_image_buffers(napi_env env, decoded_image *image, napi_value *pixel_buffer,
+                                        napi_value *unfiltered_palette_buffer, napi_value *filtered_palette_buffer) {
+  size_t data_size = (size_t)image->width * image->height * image->frame_count;
+  napi_status status = create_owned_buffer(env, (void **)&image->pixels, data_size, pixel_buffer);
+  if (status != napi_ok) return status;
+
+  return create_palette_buffers(env, image, unfiltered_palette_buffer, filtered_palette_buffer);
+}
+
+// Hands the occupancy maps of every frame of a decoded image to JS
+static napi_status create_occupancy_buffer(napi_env env, decoded_image *image, napi_value *occupancy_buffer) {
+  size_t size = occupancy_size(image->width, image->height) * image->frame_count;
+  return create_owned_buffer(env, (void **)&image->occupancy, size, occupancy_buffer);
+}
+
+napi_status call_image_callback(napi_env env, napi_value cb, int error, decoded_image *image) {
+  napi_status status;
+  napi_value args[7];
+  napi_value result;
+
+  if (error) {
+    status = create_gif_error(env, error, &args[0]);
+    if (status != napi_ok) return status;
+    return napi_call_function(env, cb, cb, 1, args, &result);
+  }
+
+  status = napi_get_null(env, &args[0]);
+  if (status != napi_ok) return status;
+
+  status = napi_create_int32(env, image->width, &args[1]);
+  if (status != napi_ok) return status;
+
+  status = napi_create_int32(env, image->height, &args[2]);
+  if (status != napi_ok) return status;
+
+  status = create_image_buffers(env, image, &args[3], &args[4], &args[5]);
+  if (status != napi_ok) return status;
+
+  status = create_occupancy_buffer(env, image, &args[6]);
+  if (status != napi_ok) return status;
+
+  return napi_call_function(env, cb, cb, 7, args, &result);
+}
+
+napi_status call_frames_callback(napi_env env, napi_value cb, int error, decoded_image *image) {
+  napi_status status;
+  napi_value args[9];
+  napi_value result;
+
+  if (error) {
+    status = create_gif_error(env, error, &args[0]);
+    if (status != napi_ok) return status;
+    return napi_call_function(env, cb, cb, 1, args, &result);
+  }
+
+  status = napi_get_null(env, &args[0]);
+  if (status != napi_ok) return status;
+
+  status = napi_create_int32(env, image->width, &args[1]);
+  if (status != napi_ok) return status;
+
+  status = napi_create_int32(env, image->height, &args[2]);
+  if (status != napi_ok) return status;
+
+  status = napi_create_int32(env, image->frame_count, &args[3]);
+  if (status != napi_ok) return status;
+
+  status = create_image_buffers(env, image, &args[4], &args[5], &args[6]);
+  if (status != napi_ok) return status;
+
+  status = napi_create_array_with_length(env, image->delays.size(), &args[7]);
+  if (status != napi_ok) return status;
+  for (size_t i = 0; i < image->delays.size(); i++) {
+    napi_value delay;
+    status = napi_create_int32(env, image->delays[i], &delay);
+    if (status != napi_ok) return status;
+    status = napi_set_element(env, args[7], i, delay);
+    if (status != napi_ok) return status;
+  }
+
+  status = create_occupancy_buffer(env, image, &args[8]);
+  if (status != napi_ok) return status;
+
+  return napi_call_function(env, cb, cb, 9, args, &result);
+}
+
+napi_status call_rle_callback(napi_env env, napi_value cb, int error, decoded_image *image, rle_image *rle) {
+  napi_status status;
+  napi_value args[8];
+  napi_value result;
+
+  if (error) {
+    status = create_gif_error(env, error, &args[0]);
+    if (status != napi_ok) return status;
+    return napi_call_function(env, cb, cb, 1, args, &result);
+  }
+
+  status = napi_get_null(env, &args[0]);
+  if (status != napi_ok) return status;
+
+  status = napi_create_int32(env, rle->width, &args[1]);
+  if (status != napi_ok) return status;
+
+  status = napi_create_int32(env, rle->height, &args[2]);
+  if (status != napi_ok) return status;
+
+  status = create_owned_buffer(env, (void **)&rle->runs, rle->run_count * sizeof(rle_run), &args[3]);
+  if (status != napi_ok) return status;
+
+  status = create_palette_buffers(env, image, &args[4], &args[5]);
+  if (status != napi_ok) return status;
+
+  status = create_occupancy_buffer(env, image, &args[6]);
+  if (status != napi_ok) return status;
+
+  status = create_owned_buffer(env, (void **)&rle->row_starts, (rle->height + 1) * sizeof(uint32_t), &args[7]);
+  if (status != napi_ok) return status;
+
+  return napi_call_function(env, cb, cb, 8, args, &result);
+}
+
+napi_status create_image_object(napi_env env, int error, decoded_image *image, napi_value *result) {
+  napi_status status;
+  napi_value value;
+  napi_value pixel_buffer;
+  napi_value unfiltered_palette_buffer;
+  napi_value filtered_palette_buffer;
+  napi_value occupancy_buffer;
+
+  if (error) return create_gif_error(env, error, result);
+
+  status = napi_create_object(env, result);
+  if (status != napi_ok) return status;
+
+  status = napi_create_int32(env, image->width, &value);
+  if (status != napi_ok) return status;
+  status = napi_set_named_property(env, *result, "width", value);
+  if (status != napi_ok) return status;
+
+  status = napi_create_int32(env, image->height, &value);
+  if (status != napi_ok) return status;
+  status = napi_set_named_property(env, *result, "height", value);
+  if (status != napi_ok) return status;
+
+  status = create_image_buffers(env, image, &pixel_buffer, &unfiltered_palette_buffer, &filtered_palette_buffer);
+  if (status != napi_ok) return status;
+
+  status = napi_set_named_property(env, *result, "pixels", pixel_buffer);
+  if (status != napi_ok) return status;
+  status = napi_set_named_property(env, *result, "unfiltered_palette", unfiltered_palette_buffer);
+  if (status != napi_ok) return status;
+  status = napi_set_named_property(env, *result, "filtered_palette", filtered_palette_buffer);
+  if (status != napi_ok) return status;
+
+  status = create_occupancy_buffer(env, image, &occupancy_buffer);
+  if (status != napi_ok) return status;
+  return napi_set_named_property(env, *result, "occupancy", occupancy_buffer);
+}
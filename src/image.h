@@ -0,0 +1,114 @@
+#ifndef NODE_GIFBLOBBER_SRC_IMAGE_H
+#define NODE_GIFBLOBBER_SRC_IMAGE_H
+
+#include <node_api.h>
+#include <gif_lib.h>
+#include <stdint.h>
+#include <vector>
+#include "rle.h"
+#include "scan.h"
+
+struct occupancy_builder;
+
+static const int UNFILTERED_BLANK_OUT_UNTIL = 6;
+static const int FILTERED_BLANK_OUT_UNTIL = 9;
+
+struct decoded_image {
+  int width;
+  int height;
+  int frame_count;
+
+  // malloc'd so that it can be handed to JS as an external buffer as-is.
+  // Holds frame_count screen-sized rasters back to back.
+  unsigned char *pixels;
+  unsigned char *occupancy; // malloc'd too, a map per frame; see occupancy.h
+  std::vector<int> delays; // Per frame, in hundredths of a second
+  uint32_t filtered_palette[256];
+  uint32_t unfiltered_palette[256];
+};
+
+// Part of the screen, right and bottom exclusive
+struct image_region {
+  int left;
+  int top;
+  int right;
+  int bottom;
+};
+
+/*
+ * Decodes the first image of an opened GIF into a freshly allocated
+ * screen-sized raster and builds its palettes and occupancy map.
+ * Returns a giflib error code, or 0.
+ */
+int read_first_image(GifFileType *gif_file, decoded_image *image);
+
+/*
+ * The same for a GIF that is entirely in memory, which skips giflib's read
+ * callbacks altogether. If region is given only that part of the screen is
+ * kept, and decoding stops after the last row it needs.
+ */
+int decode_first_image(const unsigned char *gif, size_t length, const image_region *region, decoded_image *image);
+
+/*
+ * Decodes every frame of a GIF in memory, compositing each onto the result
+ * of the ones before it according to their offsets, transparency and
+ * disposal methods. Indices refer to the global color table.
+ * Returns a giflib error code, or 0.
+ */
+int decode_all_frames(const unsigned char *gif, size_t length, decoded_image *image);
+
+/*
+ * Decompresses one scanned frame into pixels (frame.width * frame.height
+ * bytes, rows in stored order). Returns a giflib error code, or 0.
+ */
+int decode_frame(const unsigned char *gif, const gif_frame &frame, unsigned char *pixels);
+
+/*
+ * The same, but stopping once the first stored_rows rows are out. Given an
+ * occupancy builder, the rows are top rows down the raster it maps, and
+ * each band of it is mapped as soon as its rows are out.
+ */
+int decode_frame_rows(const unsigned char *gif, const gif_frame &frame, int stored_rows, unsigned char *pixels,
+                      occupancy_builder *occupancy, int top);
+
+void free_image(decoded_image *image);
+
+napi_status create_gif_error(napi_env env, int error, napi_value *result);
+
+/*
+ * Hands a malloc'd block to JS as a buffer, which becomes its backing
+ * store so nothing is copied on the main thread, unless the runtime will
+ * not take external memory. *data is cleared once JS owns it.
+ */
+napi_status create_owned_buffer(napi_env env, void **data, size_t size, napi_value *buffer);
+
+/*
+ * Calls cb(err) if error is set, otherwise
+ * cb(null, width, height, pixels, unfiltered_palette, filtered_palette, occupancy).
+ * Ownership of the pixels and occupancy map passes to the JS buffers.
+ */
+napi_status call_image_callback(napi_env env, napi_value cb, int error, decoded_image *image);
+
+/*
+ * An Error if error is set, otherwise
+ * { width, height, pixels, unfiltered_palette, filtered_palette, occupancy }.
+ * Ownership of the pixels and occupancy map passes to the JS buffers.
+ */
+napi_status create_image_object(napi_env env, int error, decoded_image *image, napi_value *result);
+
+/*
+ * Calls cb(err) if error is set, otherwise
+ * cb(null, width, height, frame_count, pixels, unfiltered_palette, filtered_palette, delays, occupancy)
+ * where pixels and occupancy hold every frame's back to back.
+ */
+napi_status call_frames_callback(napi_env env, napi_value cb, int error, decoded_image *image);
+
+/*
+ * Calls cb(err) if error is set, otherwise
+ * cb(null, width, height, runs, unfiltered_palette, filtered_palette, occupancy, row_starts)
+ * with the palettes and occupancy map taken from image. Ownership of the
+ * map, runs and row starts passes to the JS buffers.
+ */
+napi_status call_rle_callback(napi_env env, napi_value cb, int error, decoded_image *image, rle_image *rle);
+
+#endif
@@ -0,0 +1,441 @@
+#include "kernels.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <algorithm>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define HAVE_AVX2_KERNELS 1
+#include <immintrin.h>
+#endif
+
+/*
+ * How the scalar kernels turn an index into a pixel: through a palette, or
+ * as the index itself
+ */
+struct palette_lookup {
+  const int *palette;
+  int operator()(int index) const { return palette[index]; }
+};
+
+struct short_palette_lookup { // Counting the entries that show as it goes
+  const int *palette;
+  int *shown;
+  uint16_t operator()(int index) const {
+    int entry = palette[index];
+    *shown += entry >> 16;
+    return (uint16_t)entry;
+  }
+};
+
+struct index_lookup {
+  unsigned char operator()(int index) const { return (unsigned char)index; }
+};
+
+template <typename Pixel, typename Lookup>
+static void zoom_out_row_scalar(const unsigned char *row, const int *columns, int count,
+                                Pixel *output, Lookup lookup) {
+  for (int x = 0; x < count; x++) {
+    output[x] = lookup(row[columns[x]]);
+  }
+}
+
+static void zoom_out_row_scalar(const unsigned char *row, int readable_past_row,
+                                const int *columns, int count, int *output, const int *palette) {
+  zoom_out_row_scalar(row, columns, count, output, palette_lookup { palette });
+}
+
+static int zoom_out_row_scalar(const unsigned char *row, int readable_past_row,
+                               const int *columns, int count, uint16_t *output, const int *palette) {
+  int shown = 0;
+  zoom_out_row_scalar(row, columns, count, output, short_palette_lookup { palette, &shown });
+  return shown;
+}
+
+static void zoom_out_row_scalar(const unsigned char *row, int readable_past_row,
+                                const int *columns, int count, unsigned char *output) {
+  zoom_out_row_scalar(row, columns, count, output, index_lookup());
+}
+
+static void max_rows_scalar(const unsigned char *row, int width, unsigned char *maxima) {
+  for (int x = 0; x < width; x++) {
+    if (row[x] > maxima[x]) maxima[x] = row[x];
+  }
+}
+
+static void sum_rows_scalar(const unsigned char *row, int width, uint32_t *sums) {
+  for (int x = 0; x < width; x++) sums[x] += row[x];
+}
+
+template <typename Pixel, typename Lookup>
+static void interp_quad_scalar(int ul, int ur, int bl, int br, int width, int height, int first_row, int last_row,
+                               Pixel *output, int output_stride, Lookup lookup) {
+    if (width <= 0 || height <= 0) return;
+
+    int leftIncr = (bl-ul)/height;
+    int rightIncr = (br-ur)/height;
+
+    int horizIncr = (ur-ul)/width;
+    int sideDeltaIncr = (rightIncr - leftIncr)/width;
+
+    // Skipped rows still step the accumulators, as if they had been drawn
+    int left = ul + first_row*leftIncr;
+    horizIncr += first_row*sideDeltaIncr;
+    output += first_row*output_stride;
+    for (int y = first_row; y < last_row; y++) {
+        int val = left;
+        Pixel *row_ptr = output;
+        for (int x = 0; x < width; x++) {
+            *row_ptr = lookup(0xff & ((val + (1<<(SHIFT-1))) >> SHIFT));
+
+            row_ptr++;
+
+            val += horizIncr;
+        }
+        output += output_stride;
+        horizIncr += sideDeltaIncr;
+        left += leftIncr;
+    }
+}
+
+static void interp_quad_scalar(int ul, int ur, int bl, int br, int width, int height, int first_row, int last_row,
+                               int *output, int output_stride, const int *palette) {
+  interp_quad_scalar(ul, ur, bl, br, width, height, first_row, last_row, output, output_stride,
+                     palette_lookup { palette });
+}
+
+static long long interp_quad_scalar(int ul, int ur, int bl, int br, int width, int height, int first_row, int last_row,
+                                    uint16_t *output, int output_stride, const int *palette) {
+  int shown = 0;
+  interp_quad_scalar(ul, ur, bl, br, width, height, first_row, last_row, output, output_stride,
+                     short_palette_lookup { palette, &shown });
+  return shown;
+}
+
+static void interp_quad_scalar(int ul, int ur, int bl, int br, int width, int height, int first_row, int last_row,
+                               unsigned char *output, int output_stride) {
+  interp_quad_scalar(ul, ur, bl, br, width, height, first_row, last_row, output, output_stride,
+                     index_lookup());
+}
+
+// Rounds toward negative infinity, for any signs
+static inline long long floor_divide(long long a, long long b) {
+  long long quotient = a / b;
+  return quotient * b != a && (a < 0) != (b < 0) ? quotient - 1 : quotient;
+}
+
+long long interp_quad_count_above(int ul, int ur, int bl, int br, int width, int height, int first_row, int last_row,
+                                  int threshold) {
+    if (width <= 0 || height <= 0 || last_row <= first_row) return 0;
+
+    // A pixel's index is above threshold once its value, rounded, reaches
+    // the next one
+    long long reach = ((long long)(threshold+1) << SHIFT) - (1<<(SHIFT-1));
+
+    // Values stay between the corners but for what truncating the
+    // increments drifts them by, so most quads are wholly one side
+    long long drift = (long long)width*height + width + 3LL*height + 4;
+    int lowest = std::min(std::min(ul, ur), std::min(bl, br));
+    int highest = std::max(std::max(ul, ur), std::max(bl, br));
+    if (highest + drift < reach) return 0;
+    if (lowest - drift >= reach) return (long long)(last_row - first_row) * width;
+
+    int leftIncr = (bl-ul)/height;
+    int rightIncr = (br-ur)/height;
+
+    int horizIncr = (ur-ul)/width;
+    int sideDeltaIncr = (rightIncr - leftIncr)/width;
+
+    long long count = 0;
+    int left = ul + first_row*leftIncr;
+    horizIncr += first_row*sideDeltaIncr;
+    for (int y = first_row; y < last_row; y++) {
+        // Pixel x has value left + x*horizIncr
+        long long short_by = reach - left;
+        if (horizIncr == 0) {
+            if (short_by <= 0) count += width;
+        } else if (horizIncr > 0) {
+            long long first = short_by <= 0 ? 0 : floor_divide(short_by + horizIncr - 1, horizIncr);
+            if (first < width) count += width - first;
+        } else {
+            long long last = floor_divide(short_by, horizIncr); // The last x still reaching
+            if (last >= 0) count += last < width ? last + 1 : width;
+        }
+        horizIncr += sideDeltaIncr;
+        left += leftIncr;
+    }
+    return count;
+}
+
+#ifdef HAVE_AVX2_KERNELS
+
+/*
+ * How the vectorized kernels write eight indices: as the palette entries
+ * they gather, whole or narrowed to 16 bits and counted, or as the indices
+ * narrowed to bytes
+ */
+struct palette_store {
+  typedef int pixel;
+  const int *palette;
+  palette_lookup scalar() const { return palette_lookup { palette }; }
+  __attribute__((target("avx2")))
+  void operator()(int *output, __m256i indices) const {
+    _mm256_storeu_si256((__m256i *)output, _mm256_i32gather_epi32(palette, indices, 4));
+  }
+};
+
+struct short_palette_store {
+  typedef uint16_t pixel;
+  const int *palette;
+  __m256i *shown_lanes; // Entries that show, counted per lane
+  int *shown; // And by the scalar tails
+  short_palette_lookup scalar() const { return short_palette_lookup { palette, shown }; }
+  __attribute__((target("avx2")))
+  void operator()(uint16_t *output, __m256i indices) const {
+    // Packing works within each half, so the halves' low quarters are
+    // brought together afterwards
+    __m256i entries = _mm256_i32gather_epi32(palette, indices, 4);
+    *shown_lanes = _mm256_add_epi32(*shown_lanes, _mm256_srli_epi32(entries, 16));
+    entries = _mm256_and_si256(entries, _mm256_set1_epi32(0xffff));
+    __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(entries, entries), 0x08);
+    _mm_storeu_si128((__m128i *)output, _mm256_castsi256_si128(packed));
+  }
+};
+
+// The sum of the eight lanes
+__attribute__((target("avx2")))
+static inline int sum_lanes(__m256i lanes) {
+  __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(lanes), _mm256_extracti128_si256(lanes, 1));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4e));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xb1));
+  return _mm_cvtsi128_si32(sum);
+}
+
+struct index_store {
+  typedef unsigned char pixel;
+  index_lookup scalar() const { return index_lookup(); }
+  __attribute__((target("avx2")))
+  void operator()(unsigned char *output, __m256i indices) const {
+    // The low byte of each lane, gathered into the low four bytes of each
+    // half
+    const __m256i low_bytes = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                               0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    __m256i packed = _mm256_shuffle_epi8(indices, low_bytes);
+    __m128i bytes = _mm_unpacklo_epi32(_mm256_castsi256_si128(packed), _mm256_extracti128_si256(packed, 1));
+    _mm_storel_epi64((__m128i *)output, bytes);
+  }
+};
+
+/*
+ * The same stepping as the scalar version, but with val for eight
+ * consecutive pixels computed as left + x*horizIncr at once. Integer
+ * arithmetic makes that exactly what the running sum reaches.
+ */
+template <typename Store>
+__attribute__((target("avx2")))
+static void interp_quad_avx2(int ul, int ur, int bl, int br, int width, int height, int first_row, int last_row,
+                             typename Store::pixel *output, int output_stride, Store store) {
+    if (width <= 0 || height <= 0) return;
+
+    int leftIncr = (bl-ul)/height;
+    int rightIncr = (br-ur)/height;
+
+    int horizIncr = (ur-ul)/width;
+    int sideDeltaIncr = (rightIncr - leftIncr)/width;
+
+    const __m256i lane_numbers = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i rounding = _mm256_set1_epi32(1<<(SHIFT-1));
+    const __m256i index_mask = _mm256_set1_epi32(0xff);
+    auto lookup = store.scalar();
+
+    // Skipped rows still step the accumulators, as if they had been drawn
+    int left = ul + first_row*leftIncr;
+    horizIncr += first_row*sideDeltaIncr;
+    output += first_row*output_stride;
+    for (int y = first_row; y < last_row; y++) {
+        __m256i vals = _mm256_add_epi32(_mm256_set1_epi32(left),
+            _mm256_mullo_epi32(_mm256_set1_epi32(horizIncr), lane_numbers));
+        __m256i vals_step = _mm256_set1_epi32(8*horizIncr);
+
+        int x = 0;
+        for (; x + 8 <= width; x += 8) {
+            __m256i indices = _mm256_and_si256(
+                _mm256_srai_epi32(_mm256_add_epi32(vals, rounding), SHIFT), index_mask);
+            store(output + x, indices);
+            vals = _mm256_add_epi32(vals, vals_step);
+        }
+
+        int val = left + x*horizIncr;
+        for (; x < width; x++, val += horizIncr) {
+            output[x] = lookup(0xff & ((val + (1<<(SHIFT-1))) >> SHIFT));
+        }
+
+        output += output_stride;
+        horizIncr += sideDeltaIncr;
+        left += leftIncr;
+    }
+}
+
+__attribute__((target("avx2")))
+static void interp_quad_avx2(int ul, int ur, int bl, int br, int width, int height, int first_row, int last_row,
+                             int *output, int output_stride, const int *palette) {
+  interp_quad_avx2(ul, ur, bl, br, width, height, first_row, last_row, output, output_stride,
+                   palette_store { palette });
+}
+
+__attribute__((target("avx2")))
+static long long interp_quad_avx2(int ul, int ur, int bl, int br, int width, int height, int first_row, int last_row,
+                                  uint16_t *output, int output_stride, const int *palette) {
+  __m256i shown_lanes = _mm256_setzero_si256();
+  int shown = 0;
+  interp_quad_avx2(ul, ur, bl, br, width, height, first_row, last_row, output, output_stride,
+                   short_palette_store { palette, &shown_lanes, &shown });
+  return (long long)shown + sum_lanes(shown_lanes);
+}
+
+__attribute__((target("avx2")))
+static void interp_quad_avx2(int ul, int ur, int bl, int br, int width, int height, int first_row, int last_row,
+                             unsigned char *output, int output_stride) {
+  interp_quad_avx2(ul, ur, bl, br, width, height, first_row, last_row, output, output_stride, index_store());
+}
+
+template <typename Store>
+__attribute__((target("avx2")))
+static void zoom_out_row_avx2(const unsigned char *row, int readable_past_row,
+                              const int *columns, int count, typename Store::pixel *output, Store store) {
+  // Each byte is fetched with a 4-byte gather, which may read up to three
+  // bytes past the column. Rows that many bytes can't be read past are rare
+  // (the last one of the source), so they just take the scalar path.
+  if (readable_past_row < 3) {
+    zoom_out_row_scalar(row, columns, count, output, store.scalar());
+    return;
+  }
+
+  __m256i byte_mask = _mm256_set1_epi32(0xff);
+  int x = 0;
+  for (; x + 8 <= count; x += 8) {
+    __m256i in_x = _mm256_loadu_si256((const __m256i *)(columns + x));
+    store(output + x, _mm256_and_si256(_mm256_i32gather_epi32((const int *)row, in_x, 1), byte_mask));
+  }
+
+  zoom_out_row_scalar(row, columns + x, count - x, output + x, store.scalar());
+}
+
+__attribute__((target("avx2")))
+static void zoom_out_row_avx2(const unsigned char *row, int readable_past_row,
+                              const int *columns, int count, int *output, const int *palette) {
+  zoom_out_row_avx2(row, readable_past_row, columns, count, output, palette_store { palette });
+}
+
+__attribute__((target("avx2")))
+static int zoom_out_row_avx2(const unsigned char *row, int readable_past_row,
+                             const int *columns, int count, uint16_t *output, const int *palette) {
+  __m256i shown_lanes = _mm256_setzero_si256();
+  int shown = 0;
+  zoom_out_row_avx2(row, readable_past_row, columns, count, output, short_palette_store { palette, &shown_lanes, &shown });
+  return shown + sum_lanes(shown_lanes);
+}
+
+__attribute__((target("avx2")))
+static void zoom_out_row_avx2(const unsigned char *row, int readable_past_row,
+                              const int *columns, int count, unsigned char *output) {
+  zoom_out_row_avx2(row, readable_past_row, columns, count, output, index_store());
+}
+
+__attribute__((target("avx2")))
+static void max_rows_avx2(const unsigned char *row, int width, unsigned char *maxima) {
+  int x = 0;
+  for (; x + 32 <= width; x += 32) {
+    __m256i a = _mm256_loadu_si256((const __m256i *)(row + x));
+    __m256i b = _mm256_loadu_si256((const __m256i *)(maxima + x));
+    _mm256_storeu_si256((__m256i *)(maxima + x), _mm256_max_epu8(a, b));
+  }
+  max_rows_scalar(row + x, width - x, maxima + x);
+}
+
+__attribute__((target("avx2")))
+static void sum_rows_avx2(const unsigned char *row, int width, uint32_t *sums) {
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    __m256i bytes = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(row + x)));
+    __m256i total = _mm256_loadu_si256((const __m256i *)(sums + x));
+    _mm256_storeu_si256((__m256i *)(sums + x), _mm256_add_epi32(total, bytes));
+  }
+  sum_rows_scalar(row + x, width - x, sums + x);
+}
+
+#endif
+
+static bool use_simd() {
+  if (getenv("GIFBLOBBER_NO_SIMD")) return false;
+#ifdef HAVE_AVX2_KERNELS
+  return __builtin_cpu_supports("avx2");
+#else
+  return false;
+#endif
+}
+
+/*
+ * The vectorized overload of a kernel with the given signature if the CPU
+ * has AVX2, else the scalar one
+ */
+#ifdef HAVE_AVX2_KERNELS
+#define PICK_KERNEL(type, name) (use_simd() ? (type)name##_avx2 : (type)name##_scalar)
+#else
+#define PICK_KERNEL(type, name) ((type)name##_scalar)
+#endif
+
+typedef void (*zoom_out_row_kernel)(const unsigned char *, int, const int *, int, int *, const int *);
+typedef int (*zoom_out_row_short_kernel)(const unsigned char *, int, const int *, int, uint16_t *, const int *);
+typedef void (*zoom_out_row_index_kernel)(const unsigned char *, int, const int *, int, unsigned char *);
+typedef void (*interp_quad_kernel)(int, int, int, int, int, int, int, int, int *, int, const int *);
+typedef long long (*interp_quad_short_kernel)(int, int, int, int, int, int, int, int, uint16_t *, int, const int *);
+typedef void (*interp_quad_index_kernel)(int, int, int, int, int, int, int, int, unsigned char *, int);
+
+void interp_quad(int ul, int ur, int bl, int br, int width, int height, int first_row, int last_row,
+                 int *output, int output_stride, const int *palette) {
+  static const interp_quad_kernel kernel = PICK_KERNEL(interp_quad_kernel, interp_quad);
+  kernel(ul, ur, bl, br, width, height, first_row, last_row, output, output_stride, palette);
+}
+
+long long interp_quad(int ul, int ur, int bl, int br, int width, int height, int first_row, int last_row,
+                      uint16_t *output, int output_stride, const int *palette) {
+  static const interp_quad_short_kernel kernel = PICK_KERNEL(interp_quad_short_kernel, interp_quad);
+  return kernel(ul, ur, bl, br, width, height, first_row, last_row, output, output_stride, palette);
+}
+
+void interp_quad(int ul, int ur, int bl, int br, int width, int height, int first_row, int last_row,
+                 unsigned char *output, int output_stride) {
+  static const interp_quad_index_kernel kernel = PICK_KERNEL(interp_quad_index_kernel, interp_quad);
+  kernel(ul, ur, bl, br, width, height, first_row, last_row, output, output_stride);
+}
+
+void zoom_out_row(const unsigned char *row, int readable_past_row,
+                  const int *columns, int count, int *output, const int *palette) {
+  static const zoom_out_row_kernel kernel = PICK_KERNEL(zoom_out_row_kernel, zoom_out_row);
+  kernel(row, readable_past_row, columns, count, output, palette);
+}
+
+int zoom_out_row(const unsigned char *row, int readable_past_row,
+                 const int *columns, int count, uint16_t *output, const int *palette) {
+  static const zoom_out_row_short_kernel kernel = PICK_KERNEL(zoom_out_row_short_kernel, zoom_out_row);
+  return kernel(row, readable_past_row, columns, count, output, palette);
+}
+
+void zoom_out_row(const unsigned char *row, int readable_past_row,
+                  const int *columns, int count, unsigned char *output) {
+  static const zoom_out_row_index_kernel kernel = PICK_KERNEL(zoom_out_row_index_kernel, zoom_out_row);
+  kernel(row, readable_past_row, columns, count, output);
+}
+
+typedef void (*max_rows_kernel)(const unsigned char *, int, unsigned char *);
+typedef void (*sum_rows_kernel)(const unsigned char *, int, uint32_t *);
+
+void max_rows(const unsigned char *row, int width, unsigned char *maxima) {
+  static const max_rows_kernel kernel = PICK_KERNEL(max_rows_kernel, max_rows);
+  kernel(row, width, maxima);
+}
+
+void sum_rows(const unsigned char *row, int width, uint32_t *sums) {
+  static const sum_rows_kernel kernel = PICK_KERNEL(sum_rows_kernel, sum_rows);
+  kernel(row, width, sums);
+}
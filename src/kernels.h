@@ -0,0 +1,72 @@
+#ifndef NODE_GIFBLOBBER_SRC_KERNELS_H
+#define NODE_GIFBLOBBER_SRC_KERNELS_H
+
+#include <stdint.h>
+
+#define SHIFT 20
+#define ZOOM_OUT_SHIFT 15
+
+/*
+ * Inner loops of stretch, each with a scalar version and, where the CPU
+ * has it, a vectorized one picked at runtime. Both give identical output.
+ * Setting GIFBLOBBER_NO_SIMD in the environment forces the scalar ones.
+ */
+
+/*
+ * Nearest-neighbour samples one source row into count pixels: output
+ * pixel x gets the color of row[columns[x]]. Every column must lie inside
+ * the row. readable_past_row is how many bytes after the row may still be
+ * read.
+ */
+void zoom_out_row(const unsigned char *row, int readable_past_row,
+                  const int *columns, int count, int *output, const int *palette);
+
+// The same for 16-bit pixels, each palette entry holding one in its low
+// half and 1 above it if the index shows, returning how many written show.
+// Pixels without alpha can't tell that themselves. Or writing the indices
+// themselves one byte a pixel.
+int zoom_out_row(const unsigned char *row, int readable_past_row,
+                 const int *columns, int count, uint16_t *output, const int *palette);
+void zoom_out_row(const unsigned char *row, int readable_past_row,
+                  const int *columns, int count, unsigned char *output);
+
+/*
+ * Fold one source row into per-column running maxima or sums, for
+ * reducing every source row an output row covers.
+ */
+void max_rows(const unsigned char *row, int width, unsigned char *maxima);
+void sum_rows(const unsigned char *row, int width, uint32_t *sums);
+
+/*
+ * Bilinearly interpolates palette indices across a quad and writes their
+ * colors.
+ * ul - upper left corner color, left-shifted by SHIFT
+ * ur - upper right corner color, left-shifted by SHIFT
+ * bl - bottom left corner color, left-shifted by SHIFT
+ * br - bottom right corner color, left-shifted by SHIFT
+ * width, height - dimensions of quad to draw
+ * first_row, last_row - only rows [first_row, last_row) of it are drawn
+ * output - pixels to draw onto. One int per pixel
+ * output_stride - how many ints to step to move to the next row
+ * palette - 256 color entries, corresponding to interpolated colors
+ */
+void interp_quad(int ul, int ur, int bl, int br, int width, int height, int first_row, int last_row,
+                 int *output, int output_stride, const int *palette);
+
+// The same for 16-bit pixels, counted as for zoom_out_row, or writing the
+// interpolated indices themselves one byte a pixel
+long long interp_quad(int ul, int ur, int bl, int br, int width, int height, int first_row, int last_row,
+                      uint16_t *output, int output_stride, const int *palette);
+void interp_quad(int ul, int ur, int bl, int br, int width, int height, int first_row, int last_row,
+                 unsigned char *output, int output_stride);
+
+/*
+ * How many pixels of rows [first_row, last_row) of a quad interp_quad
+ * would give an index above threshold. Along a row the interpolated value
+ * only ever steps by the same amount, so this is worked out a row at a time
+ * rather than pixel by pixel.
+ */
+long long interp_quad_count_above(int ul, int ur, int bl, int br, int width, int height, int first_row, int last_row,
+                                  int threshold);
+
+#endif
@@ -0,0 +1,185 @@
+#include "lzw.h"
+#include <gif_lib.h>
+#include <string.h>
+
+// Where the entry for LZW_MAX_CODE lives once the table is full
+enum {
+  LAST_ENTRY_IN_OUTPUT,  // In offsets/lengths like every other entry
+  LAST_ENTRY_IN_BUFFER,  // Spelled out in last_entry[], length in lengths[]
+  LAST_ENTRY_CYCLIC      // giflib left it as its own prefix; using it is an error
+};
+
+static void reset_table(lzw_decoder *decoder) {
+  decoder->running_code = decoder->eoi_code + 1;
+  decoder->running_bits = 0;
+  while ((1 << decoder->running_bits) < decoder->clear_code) decoder->running_bits++;
+  decoder->running_bits++;
+  decoder->max_code1 = 1 << decoder->running_bits;
+  decoder->defined = decoder->eoi_code + 1;
+  decoder->previous_code = -1;
+  decoder->last_entry_state = LAST_ENTRY_IN_OUTPUT;
+}
+
+void lzw_init(lzw_decoder *decoder, int min_code_size, unsigned char *output, size_t output_length) {
+  decoder->output = output;
+  decoder->output_length = output_length;
+  decoder->position = 0;
+  decoder->bits = 0;
+  decoder->bit_count = 0;
+  decoder->error = 0;
+  decoder->finished = output_length == 0;
+
+  if (min_code_size < 0 || min_code_size > LZW_BITS - 1) {
+    decoder->error = D_GIF_ERR_IMAGE_DEFECT;
+    min_code_size = 0;
+  }
+  decoder->clear_code = 1 << min_code_size;
+  decoder->eoi_code = decoder->clear_code + 1;
+  reset_table(decoder);
+}
+
+static inline uint64_t load_le64(const unsigned char *p) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  uint64_t word = 0;
+  for (int i = 7; i >= 0; i--) word = (word << 8) | p[i];
+  return word;
+#else
+  uint64_t word;
+  memcpy(&word, p, 8);
+  return word;
+#endif
+}
+
+/*
+ * Copies length bytes that end at or before dest. Short strings dominate, so
+ * when there is room they are moved as one 16 byte block; the excess is
+ * overwritten by whatever is emitted next.
+ */
+static inline void copy_string(lzw_decoder *decoder, unsigned char *dest, const unsigned char *src, size_t length) {
+  const unsigned char *output_end = decoder->output + decoder->output_length;
+  if (length <= 16 && dest + 16 <= output_end && src + 16 <= output_end) {
+    uint64_t block[2];
+    memcpy(block, src, 16);
+    memcpy(dest, block, 16);
+  } else {
+    memcpy(dest, src, length);
+  }
+}
+
+int lzw_decode(lzw_decoder *decoder, const unsigned char *codes, size_t length) {
+  const unsigned char *end = codes + length;
+
+  unsigned char *output = decoder->output;
+  size_t position = decoder->position;
+  uint64_t bits = decoder->bits;
+  int bit_count = decoder->bit_count;
+
+  if (decoder->error) return decoder->error;
+
+  while (!decoder->finished) {
+    if (bit_count < decoder->running_bits) {
+      if (end - codes >= 8) {
+        // Top the buffer up to at least 56 bits with one load
+        bits |= load_le64(codes) << bit_count;
+        codes += (63 - bit_count) >> 3;
+        bit_count |= 56;
+      } else {
+        while (bit_count < decoder->running_bits) {
+          if (codes == end) goto out;
+          bits |= (uint64_t)*codes++ << bit_count;
+          bit_count += 8;
+        }
+      }
+    }
+    int code = bits & ((1 << decoder->running_bits) - 1);
+    bits >>= decoder->running_bits;
+    bit_count -= decoder->running_bits;
+
+    // Same width bookkeeping as giflib, including the deferred clear case
+    if (decoder->running_code < LZW_MAX_CODE + 2 &&
+        ++decoder->running_code > decoder->max_code1 &&
+        decoder->running_bits < LZW_BITS) {
+      decoder->max_code1 <<= 1;
+      decoder->running_bits++;
+    }
+
+    if (code == decoder->eoi_code) {
+      decoder->error = D_GIF_ERR_EOF_TOO_SOON;
+      break;
+    }
+    if (code == decoder->clear_code) {
+      reset_table(decoder);
+      continue;
+    }
+
+    int slot = decoder->running_code - 2;
+    size_t room = decoder->output_length - position;
+    size_t string_length;
+
+    if (code < decoder->clear_code) {
+      output[position] = (unsigned char)code;
+      string_length = 1;
+    } else if (code < decoder->defined) {
+      string_length = decoder->lengths[code];
+      size_t copy_length = string_length < room ? string_length : room;
+      if (code == LZW_MAX_CODE && decoder->last_entry_state == LAST_ENTRY_IN_BUFFER) {
+        memcpy(output + position, decoder->last_entry, copy_length);
+      } else if (code == LZW_MAX_CODE && decoder->last_entry_state == LAST_ENTRY_CYCLIC) {
+        decoder->error = D_GIF_ERR_IMAGE_DEFECT;
+        break;
+      } else {
+        copy_string(decoder, output + position, output + decoder->offsets[code], copy_length);
+      }
+    } else if (code == slot && decoder->previous_code >= 0) {
+      // The code being defined right now: the previous string plus its own first byte
+      string_length = decoder->previous_length + 1;
+      size_t head_length = (size_t)decoder->previous_length < room ? decoder->previous_length : room;
+      copy_string(decoder, output + position, output + decoder->previous_position, head_length);
+      if (string_length <= room) {
+        output[position + string_length - 1] = output[decoder->previous_position];
+      }
+    } else {
+      decoder->error = D_GIF_ERR_IMAGE_DEFECT;
+      break;
+    }
+
+    if (string_length >= room) {
+      position += room;
+      decoder->finished = true;
+      break;
+    }
+
+    if (decoder->previous_code >= 0) {
+      if (slot >= decoder->defined) {
+        decoder->offsets[slot] = (uint32_t)decoder->previous_position;
+        decoder->lengths[slot] = (uint16_t)(decoder->previous_length + 1);
+        decoder->defined = slot + 1;
+      } else if (decoder->previous_code == LZW_MAX_CODE) {
+        // giflib points the entry at its own previous definition
+        decoder->last_entry_state = LAST_ENTRY_CYCLIC;
+      } else if (code == LZW_MAX_CODE) {
+        // giflib takes the new last byte from the redefined chain, which
+        // leads back to the previous string rather than the one just emitted
+        memcpy(decoder->last_entry, output + decoder->previous_position, decoder->previous_length);
+        decoder->last_entry[decoder->previous_length] = output[decoder->previous_position];
+        decoder->lengths[slot] = (uint16_t)(decoder->previous_length + 1);
+        decoder->last_entry_state = LAST_ENTRY_IN_BUFFER;
+      } else {
+        decoder->offsets[slot] = (uint32_t)decoder->previous_position;
+        decoder->lengths[slot] = (uint16_t)(decoder->previous_length + 1);
+        decoder->last_entry_state = LAST_ENTRY_IN_OUTPUT;
+      }
+    }
+
+    decoder->previous_code = code;
+    decoder->previous_position = position;
+    decoder->previous_length = (int)string_length;
+    position += string_length;
+  }
+
+out:
+  decoder->position = position;
+  decoder->bits = bits;
+  decoder->bit_count = bit_count;
+  return decoder->error;
+}
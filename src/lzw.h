@@ -0,0 +1,61 @@
+#ifndef NODE_GIFBLOBBER_SRC_LZW_H
+#define NODE_GIFBLOBBER_SRC_LZW_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LZW_MAX_CODE 4095
+#define LZW_BITS 12
+
+/*
+ * GIF LZW decompressor.
+ *
+ * Each dictionary entry is kept as the (offset, length) of a place in the
+ * output where its string has already been written, so emitting a code is a
+ * single forward copy instead of a walk down a prefix chain into a stack.
+ * For that to work the whole image has to be decoded into one buffer.
+ *
+ * The code stream is fed in pieces of any size, though long contiguous
+ * pieces are fastest since the bit buffer is then refilled 64 bits at a
+ * time. Decoding stops as soon as the output is full. Output matches giflib's DGifDecompressLine exactly,
+ * including how it keeps redefining code 4095 once the table is full.
+ */
+struct lzw_decoder {
+  unsigned char *output;
+  size_t output_length;
+  size_t position;
+
+  int clear_code;
+  int eoi_code;
+  int running_code; // Two past the code the next entry is assigned to
+  int running_bits;
+  int max_code1;
+  int defined; // Codes below this have an entry in the current table
+
+  int previous_code; // -1 right after a clear
+  size_t previous_position;
+  int previous_length;
+
+  uint64_t bits;
+  int bit_count;
+
+  int error; // giflib error code
+  bool finished;
+
+  // See lzw.cc: how the entry for LZW_MAX_CODE is held once the table is full
+  int last_entry_state;
+  unsigned char last_entry[LZW_MAX_CODE + 2];
+
+  uint32_t offsets[LZW_MAX_CODE + 1];
+  uint16_t lengths[LZW_MAX_CODE + 1];
+};
+
+void lzw_init(lzw_decoder *decoder, int min_code_size, unsigned char *output, size_t output_length);
+
+/*
+ * Decompresses the next piece of the code stream. Returns a giflib error
+ * code, or 0. decoder->finished is set once the output is full.
+ */
+int lzw_decode(lzw_decoder *decoder, const unsigned char *codes, size_t length);
+
+#endif
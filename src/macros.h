@@ -58,3 +58,71 @@
   } \
   status = napi_create_reference(env, argv[ARG_INDEX], 1, &REF); \
   if (status != napi_ok) goto out;
+
+#define REQUIRE_ARGUMENT_EXTERNAL(ARG_INDEX, TYPE, NAME) \
+  TYPE *NAME; \
+  { \
+    napi_valuetype value_type; \
+    status = napi_typeof(env, argv[ARG_INDEX], &value_type); \
+    if (status != napi_ok || value_type != napi_external) { \
+      error = invalid_arguments_error; \
+      goto out; \
+    } \
+  } \
+  status = napi_get_value_external(env, argv[ARG_INDEX], (void **)&NAME); \
+  if (status != napi_ok) { \
+    error = invalid_arguments_error; \
+    goto out; \
+  }
+
+// Leaves NAME as it was if OBJECT has no such property
+#define OPTIONAL_PROPERTY_INTEGER(OBJECT, KEY, NAME) \
+  { \
+    bool has_property; \
+    status = napi_has_named_property(env, OBJECT, KEY, &has_property); \
+    if (status != napi_ok) goto out; \
+    if (has_property) { \
+      napi_value property; \
+      status = napi_get_named_property(env, OBJECT, KEY, &property); \
+      if (status != napi_ok) goto out; \
+      status = napi_get_value_int32(env, property, &NAME); \
+      if (status != napi_ok) { \
+        error = invalid_arguments_error; \
+        goto out; \
+      } \
+    } \
+  }
+
+#define OPTIONAL_PROPERTY_DOUBLE(OBJECT, KEY, NAME) \
+  { \
+    bool has_property; \
+    status = napi_has_named_property(env, OBJECT, KEY, &has_property); \
+    if (status != napi_ok) goto out; \
+    if (has_property) { \
+      napi_value property; \
+      status = napi_get_named_property(env, OBJECT, KEY, &property); \
+      if (status != napi_ok) goto out; \
+      status = napi_get_value_double(env, property, &NAME); \
+      if (status != napi_ok) { \
+        error = invalid_arguments_error; \
+        goto out; \
+      } \
+    } \
+  }
+
+#define OPTIONAL_PROPERTY_BOOLEAN(OBJECT, KEY, NAME) \
+  { \
+    bool has_property; \
+    status = napi_has_named_property(env, OBJECT, KEY, &has_property); \
+    if (status != napi_ok) goto out; \
+    if (has_property) { \
+      napi_value property; \
+      status = napi_get_named_property(env, OBJECT, KEY, &property); \
+      if (status != napi_ok) goto out; \
+      status = napi_get_value_bool(env, property, &NAME); \
+      if (status != napi_ok) { \
+        error = invalid_arguments_error; \
+        goto out; \
+      } \
+    } \
+  }
@@ -1,7 +1,19 @@
 #include <node_api.h>
 
 napi_value slurp(napi_env env, napi_callback_info cbinfo);
+napi_value slurp_frames(napi_env env, napi_callback_info cbinfo);
+napi_value slurp_file(napi_env env, napi_callback_info cbinfo);
+napi_value slurp_many(napi_env env, napi_callback_info cbinfo);
+napi_value probe(napi_env env, napi_callback_info cbinfo);
 napi_value stretch(napi_env env, napi_callback_info cbinfo);
+napi_value stretch_rle(napi_env env, napi_callback_info cbinfo);
+napi_value stretch_to_png(napi_env env, napi_callback_info cbinfo);
+napi_value stretch_to_gif(napi_env env, napi_callback_info cbinfo);
+napi_value render_pyramid(napi_env env, napi_callback_info cbinfo);
+napi_value build_mipmaps(napi_env env, napi_callback_info cbinfo);
+napi_value create_decoder(napi_env env, napi_callback_info cbinfo);
+napi_value decoder_push(napi_env env, napi_callback_info cbinfo);
+napi_value decoder_end(napi_env env, napi_callback_info cbinfo);
 
 #define CREATE_FUNCTION(NAME, IMPLEMENTATION) \
   status = napi_create_function(env, nullptr, 0, IMPLEMENTATION, nullptr, &fn); \
@@ -14,7 +26,19 @@ napi_value init(napi_env env, napi_value exports) {
   napi_value fn;
 
   CREATE_FUNCTION("slurp", slurp);
+  CREATE_FUNCTION("slurpFrames", slurp_frames);
+  CREATE_FUNCTION("slurpFile", slurp_file);
+  CREATE_FUNCTION("slurpMany", slurp_many);
+  CREATE_FUNCTION("probe", probe);
   CREATE_FUNCTION("stretch", stretch);
+  CREATE_FUNCTION("stretchRle", stretch_rle);
+  CREATE_FUNCTION("stretchToPng", stretch_to_png);
+  CREATE_FUNCTION("stretchToGif", stretch_to_gif);
+  CREATE_FUNCTION("renderPyramid", render_pyramid);
+  CREATE_FUNCTION("buildMipmaps", build_mipmaps);
+  CREATE_FUNCTION("createDecoder", create_decoder);
+  CREATE_FUNCTION("decoderPush", decoder_push);
+  CREATE_FUNCTION("decoderEnd", decoder_end);
   
   return exports;
 }
@@ -0,0 +1,67 @@
+#include "mercator.h"
+#include <math.h>
+#include <mutex>
+
+#define MERCATOR_CACHED_TABLES 16
+
+double mercator_y(double latitude) {
+  if (latitude > MERCATOR_MAX_LATITUDE) latitude = MERCATOR_MAX_LATITUDE;
+  if (latitude < -MERCATOR_MAX_LATITUDE) latitude = -MERCATOR_MAX_LATITUDE;
+  return log(tan(M_PI/4 + latitude*(M_PI/360)));
+}
+
+double mercator_latitude(double y) {
+  return atan(sinh(y))*(180/M_PI);
+}
+
+struct mercator_table {
+  double north;
+  double south;
+  int source_height;
+  double source_top;
+  double source_bottom;
+  int result_height;
+  std::shared_ptr<const std::vector<double> > rows;
+};
+
+static std::mutex cache_mutex;
+static mercator_table cache[MERCATOR_CACHED_TABLES];
+static int cache_next; // The entry replaced next, oldest first
+
+std::shared_ptr<const std::vector<double> > mercator_source_rows(double north, double south, int source_height,
+                                                                 double source_top, double source_bottom,
+                                                                 int result_height) {
+  {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    for (int i = 0; i < MERCATOR_CACHED_TABLES; i++) {
+      mercator_table &table = cache[i];
+      if (table.rows && table.north == north && table.south == south && table.source_height == source_height
+          && table.source_top == source_top && table.source_bottom == source_bottom
+          && table.result_height == result_height) {
+        return table.rows;
+      }
+    }
+  }
+
+  double rows_per_degree = source_height / (south - north);
+  double y_top = mercator_y(north + source_top / rows_per_degree);
+  double y_bottom = mercator_y(north + source_bottom / rows_per_degree);
+
+  std::shared_ptr<std::vector<double> > rows = std::make_shared<std::vector<double> >(result_height + 1);
+  for (int out_y = 0; out_y <= result_height; out_y++) {
+    double latitude = mercator_latitude(y_top + (y_bottom - y_top)*out_y/result_height);
+    (*rows)[out_y] = (latitude - north) * rows_per_degree;
+  }
+
+  std::lock_guard<std::mutex> lock(cache_mutex);
+  mercator_table &table = cache[cache_next];
+  cache_next = (cache_next + 1) % MERCATOR_CACHED_TABLES;
+  table.north = north;
+  table.south = south;
+  table.source_height = source_height;
+  table.source_top = source_top;
+  table.source_bottom = source_bottom;
+  table.result_height = result_height;
+  table.rows = rows;
+  return rows;
+}
@@ -0,0 +1,33 @@
+#ifndef NODE_GIFBLOBBER_SRC_MERCATOR_H
+#define NODE_GIFBLOBBER_SRC_MERCATOR_H
+
+#include <memory>
+#include <vector>
+
+/*
+ * Web Mercator for sources on an equirectangular grid, whose rows are
+ * evenly spaced in latitude. Latitudes are in degrees; y is the projected
+ * northing, in radians.
+ */
+
+// Web Mercator stops short of the poles, where y would be infinite
+#define MERCATOR_MAX_LATITUDE 85.0511287798066
+
+double mercator_y(double latitude);
+double mercator_latitude(double y);
+
+/*
+ * Where output rows evenly spaced in Mercator between source rows
+ * source_top and source_bottom land in the source: entry i is the
+ * (fractional) source row at the top of output row i, for i in
+ * [0, result_height]. north and south are the latitudes of the top of the
+ * source and the bottom of its last row.
+ *
+ * Tables are cached, so the rows of tiles sharing a latitude span, which is
+ * every tile in a row of a pyramid, are only worked out once.
+ */
+std::shared_ptr<const std::vector<double> > mercator_source_rows(double north, double south, int source_height,
+                                                                 double source_top, double source_bottom,
+                                                                 int result_height);
+
+#endif
@@ -0,0 +1,254 @@
+#include <node_api.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "image.h"
+#include "kernels.h"
+#include "macros.h"
+#include "parallel.h"
+#include "rle.h"
+#include "stretch.h"
+
+struct mipmap_level {
+  int width;
+  int height;
+  unsigned char *pixels; // malloc'd until handed to JS
+};
+
+struct mipmap_baton {
+  napi_async_work work; // So we can delete when we are done
+  napi_ref callback_ref;
+  napi_ref source_buffer_ref;
+  napi_ref row_starts_buffer_ref;
+
+  int source_width;
+  int source_height;
+  const unsigned char *source_pixels; // Dense, or else...
+  const rle_run *source_runs; // ...run-length encoded with these row starts
+  const uint32_t *source_row_starts;
+
+  bool out_of_memory;
+  std::vector<mipmap_level> levels; // Halving in size each time, down to 1x1
+};
+
+/*
+ * Fills level with the maximum of every 2x2 block of the one above it,
+ * whose rows row(y, scratch) gives. A trailing odd row or column is
+ * reduced on its own.
+ */
+template <typename RowSource>
+static void halve_level(const RowSource &row, int width, int height, mipmap_level *level) {
+  int bands = parallel_thread_count(level->height) * 4;
+  if (bands > level->height) bands = level->height;
+
+  parallel_for(bands, [&row, width, height, level, bands](int band) {
+    int top = (int)((long long)level->height * band / bands);
+    int bottom = (int)((long long)level->height * (band+1) / bands);
+    std::vector<unsigned char> maxima(width), scratch(width);
+
+    for (int y = top; y < bottom; y++) {
+      memcpy(maxima.data(), row(2*y, scratch.data()), width);
+      if (2*y + 1 < height) max_rows(row(2*y + 1, scratch.data()), width, maxima.data());
+
+      unsigned char *output = level->pixels + (size_t)level->width * y;
+      for (int x = 0; x < width / 2; x++) {
+        unsigned char left = maxima[2*x], right = maxima[2*x + 1];
+        output[x] = left > right ? left : right;
+      }
+      if (width & 1) output[width / 2] = maxima[width - 1];
+    }
+  });
+}
+
+static void mipmap_execute(napi_env env, void *data) {
+  mipmap_baton *baton = (mipmap_baton *)data;
+  int width = baton->source_width, height = baton->source_height;
+
+  while (width > 1 || height > 1) {
+    mipmap_level level;
+    level.width = (width + 1) / 2;
+    level.height = (height + 1) / 2;
+    level.pixels = (unsigned char *)malloc((size_t)level.width * level.height);
+    if (!level.pixels) {
+      baton->out_of_memory = true;
+      return;
+    }
+
+    if (baton->levels.empty()) {
+      halve_level([baton](int y, unsigned char *scratch) -> const unsigned char * {
+        if (!baton->source_runs) return baton->source_pixels + (size_t)baton->source_width * y;
+        rle_expand_row(baton->source_runs, baton->source_row_starts, y, scratch);
+        return scratch;
+      }, width, height, &level);
+    } else {
+      const mipmap_level &above = baton->levels.back();
+      halve_level([&above](int y, unsigned char *scratch) -> const unsigned char * {
+        return above.pixels + (size_t)above.width * y;
+      }, width, height, &level);
+    }
+
+    baton->levels.push_back(level);
+    width = level.width;
+    height = level.height;
+  }
+}
+
+static void free_levels(mipmap_baton *baton) {
+  for (size_t i = 0; i < baton->levels.size(); i++) free(baton->levels[i].pixels);
+  baton->levels.clear();
+}
+
+/*
+ * cb(null, [{ width, height, pixels }, ...]), or cb(err)
+ */
+static void mipmap_complete(napi_env env, napi_status status, void *data) {
+  mipmap_baton *baton = (mipmap_baton *)data;
+  napi_value cb, args[2], result;
+
+  status = napi_get_reference_value(env, baton->callback_ref, &cb);
+  if (status != napi_ok) goto out;
+
+  if (baton->out_of_memory) {
+    napi_value message;
+    status = napi_create_string_utf8(env, "Out of memory", NAPI_AUTO_LENGTH, &message);
+    if (status != napi_ok) goto out;
+    status = napi_create_error(env, nullptr, message, &args[0]);
+    if (status != napi_ok) goto out;
+    napi_call_function(env, cb, cb, 1, args, &result);
+    goto out;
+  }
+
+  status = napi_get_null(env, &args[0]);
+  if (status != napi_ok) goto out;
+  status = napi_create_array_with_length(env, baton->levels.size(), &args[1]);
+  if (status != napi_ok) goto out;
+
+  for (size_t i = 0; i < baton->levels.size(); i++) {
+    mipmap_level &level = baton->levels[i];
+    napi_value level_object, width, height, pixels;
+    status = napi_create_object(env, &level_object);
+    if (status != napi_ok) goto out;
+    status = napi_create_int32(env, level.width, &width);
+    if (status != napi_ok) goto out;
+    status = napi_create_int32(env, level.height, &height);
+    if (status != napi_ok) goto out;
+    status = create_owned_buffer(env, (void **)&level.pixels, (size_t)level.width * level.height, &pixels);
+    if (status != napi_ok) goto out;
+    status = napi_set_named_property(env, level_object, "width", width);
+    if (status != napi_ok) goto out;
+    status = napi_set_named_property(env, level_object, "height", height);
+    if (status != napi_ok) goto out;
+    status = napi_set_named_property(env, level_object, "pixels", pixels);
+    if (status != napi_ok) goto out;
+    status = napi_set_element(env, args[1], (uint32_t)i, level_object);
+    if (status != napi_ok) goto out;
+  }
+
+  napi_call_function(env, cb, cb, 2, args, &result);
+
+out:
+  free_levels(baton);
+  napi_delete_async_work(env, baton->work);
+  napi_delete_reference(env, baton->callback_ref);
+  napi_delete_reference(env, baton->source_buffer_ref);
+  if (baton->row_starts_buffer_ref) napi_delete_reference(env, baton->row_starts_buffer_ref);
+
+  delete baton;
+}
+
+/*
+ * buildMipmaps(source, width, height, cb[, row_starts])
+ *
+ * Max-reduces an image to half its size, then that to half again, down to
+ * a single pixel, so that zoomed-out stretches can read a level near their
+ * own size rather than the whole source. With row_starts the source is
+ * run-length encoded; the levels are always dense.
+ */
+napi_value build_mipmaps(napi_env env, napi_callback_info cbinfo) {
+  napi_status status;
+  napi_async_work work = nullptr;
+  napi_ref callback_ref = nullptr;
+  napi_ref source_buffer_ref = nullptr;
+  napi_ref row_starts_buffer_ref = nullptr;
+
+  const char *error = nullptr;
+  const char *invalid_arguments_error = "invalid argument types";
+  napi_value cbinfo_this;
+  void *cbinfo_data;
+  size_t argc = 5;
+  napi_value argv[5];
+  void *row_starts = nullptr;
+  size_t row_starts_length = 0;
+  napi_value description;
+
+  mipmap_baton *baton = nullptr;
+
+  status = napi_get_cb_info(env, cbinfo, &argc, argv, &cbinfo_this, &cbinfo_data);
+  if (status != napi_ok) goto out;
+  if (argc < 4) {
+    error = "Wrong number of arguments.";
+    goto out;
+  }
+
+  {
+    REQUIRE_ARGUMENT_BUFFER_REF(0, source_buffer, source_buffer_length, source_buffer_ref);
+    REQUIRE_ARGUMENT_INTEGER(1, source_width);
+    REQUIRE_ARGUMENT_INTEGER(2, source_height);
+
+    if (argc > 4) {
+      REQUIRE_ARGUMENT_BUFFER_REF(4, row_starts_buffer, row_starts_buffer_length, row_starts_buffer_ref);
+      row_starts = row_starts_buffer;
+      row_starts_length = row_starts_buffer_length;
+    }
+
+    error = stretch_source_error(source_buffer, source_buffer_length, row_starts, row_starts_length,
+                                 source_width, source_height, row_starts != nullptr);
+    if (error) goto out;
+
+    status = napi_create_reference(env, argv[3], 1, &callback_ref);
+    if (status != napi_ok) goto out;
+
+    status = napi_create_string_utf8(env, "gif mipmaps", NAPI_AUTO_LENGTH, &description);
+    if (status != napi_ok) goto out;
+
+    baton = new mipmap_baton();
+
+    status = napi_create_async_work(env, nullptr, description, mipmap_execute, mipmap_complete, baton, &work);
+    if (status != napi_ok) goto out;
+
+    baton->source_width = source_width;
+    baton->source_height = source_height;
+    if (row_starts) {
+      baton->source_runs = (const rle_run *)source_buffer;
+      baton->source_row_starts = (const uint32_t *)row_starts;
+    } else {
+      baton->source_pixels = (const unsigned char *)source_buffer;
+    }
+    baton->out_of_memory = false;
+    baton->work = work;
+    baton->callback_ref = callback_ref;
+    baton->source_buffer_ref = source_buffer_ref;
+    baton->row_starts_buffer_ref = row_starts_buffer_ref;
+  }
+
+  status = napi_queue_async_work(env, work);
+  if (status != napi_ok) goto out;
+
+  baton = nullptr;
+  work = nullptr;
+  callback_ref = nullptr;
+  source_buffer_ref = nullptr;
+  row_starts_buffer_ref = nullptr;
+
+out:
+  if (callback_ref) napi_delete_reference(env, callback_ref);
+  if (source_buffer_ref) napi_delete_reference(env, source_buffer_ref);
+  if (row_starts_buffer_ref) napi_delete_reference(env, row_starts_buffer_ref);
+  if (work) napi_delete_async_work(env, work);
+  if (baton) delete baton;
+
+  if (error) {
+    napi_throw_error(env, NULL, error);
+  }
+  return nullptr;
+}
@@ -0,0 +1,57 @@
+#include "occupancy.h"
+#include "image.h"
+#include "kernels.h"
+#include <string.h>
+#include <vector>
+
+size_t occupancy_size(int width, int height) {
+  return (size_t)occupancy_columns(width) * occupancy_columns(height);
+}
+
+// Maps the band of rows [top, bottom), a block high or the last of the raster
+static void map_band(const unsigned char *pixels, int width, int top, int bottom,
+                     unsigned char *maxima, unsigned char *occupancy) {
+  // The highest index in each column of the band, then of each block
+  memset(maxima, 0, width);
+  for (int y = top; y < bottom; y++) max_rows(pixels + (size_t)y*width, width, maxima);
+
+  int columns = occupancy_columns(width);
+  occupancy += (size_t)(top >> OCCUPANCY_BLOCK_SHIFT) * columns;
+  for (int block = 0; block < columns; block++) {
+    int left = block << OCCUPANCY_BLOCK_SHIFT;
+    int right = left + OCCUPANCY_BLOCK < width ? left + OCCUPANCY_BLOCK : width;
+    unsigned char highest = 0;
+    for (int x = left; x < right; x++) {
+      if (maxima[x] > highest) highest = maxima[x];
+    }
+    occupancy[block] = (highest > UNFILTERED_BLANK_OUT_UNTIL ? OCCUPIED_UNFILTERED : 0)
+                     | (highest > FILTERED_BLANK_OUT_UNTIL ? OCCUPIED_FILTERED : 0);
+  }
+}
+
+void build_occupancy(const unsigned char *pixels, int width, int height, unsigned char *occupancy) {
+  occupancy_builder builder;
+  occupancy_begin(&builder, pixels, width, height, occupancy);
+  occupancy_rows_ready(&builder, height);
+}
+
+void occupancy_begin(occupancy_builder *builder, const unsigned char *pixels, int width, int height,
+                     unsigned char *occupancy) {
+  builder->pixels = pixels;
+  builder->width = width;
+  builder->height = height;
+  builder->occupancy = occupancy;
+  builder->mapped_rows = 0;
+  builder->maxima.resize(width);
+}
+
+void occupancy_rows_ready(occupancy_builder *builder, int rows) {
+  if (rows > builder->height) rows = builder->height;
+  for (;;) {
+    int top = builder->mapped_rows;
+    int bottom = top + OCCUPANCY_BLOCK < builder->height ? top + OCCUPANCY_BLOCK : builder->height;
+    if (top == bottom || bottom > rows) return;
+    map_band(builder->pixels, builder->width, top, bottom, builder->maxima.data(), builder->occupancy);
+    builder->mapped_rows = bottom;
+  }
+}
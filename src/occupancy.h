@@ -0,0 +1,54 @@
+#ifndef NODE_GIFBLOBBER_SRC_OCCUPANCY_H
+#define NODE_GIFBLOBBER_SRC_OCCUPANCY_H
+
+#include <stddef.h>
+#include <vector>
+
+/*
+ * Which 16x16 blocks of an image hold anything that can show: a byte per
+ * block, row by row, with OCCUPIED_UNFILTERED set if some pixel in it is
+ * above UNFILTERED_BLANK_OUT_UNTIL and OCCUPIED_FILTERED if some pixel is
+ * above FILTERED_BLANK_OUT_UNTIL. Everything in a block with neither comes
+ * out blank, so stretches fill or skip such blocks in bulk.
+ */
+#define OCCUPANCY_BLOCK_SHIFT 4
+#define OCCUPANCY_BLOCK (1 << OCCUPANCY_BLOCK_SHIFT)
+
+#define OCCUPIED_UNFILTERED 1
+#define OCCUPIED_FILTERED 2
+
+// Blocks across a row of the map
+static inline int occupancy_columns(int width) {
+  return (width + OCCUPANCY_BLOCK - 1) >> OCCUPANCY_BLOCK_SHIFT;
+}
+
+// Bytes in the map of a width*height image
+size_t occupancy_size(int width, int height);
+
+/*
+ * Maps a dense width*height raster into occupancy, which holds
+ * occupancy_size(width, height) bytes.
+ */
+void build_occupancy(const unsigned char *pixels, int width, int height, unsigned char *occupancy);
+
+/*
+ * Builds the same map a band of OCCUPANCY_BLOCK rows at a time as a
+ * raster's rows come in from the top, so that each band is mapped while it
+ * is still in cache.
+ */
+struct occupancy_builder {
+  const unsigned char *pixels;
+  int width;
+  int height;
+  unsigned char *occupancy;
+  int mapped_rows; // Rows whose bands are mapped
+  std::vector<unsigned char> maxima;
+};
+
+void occupancy_begin(occupancy_builder *builder, const unsigned char *pixels, int width, int height,
+                     unsigned char *occupancy);
+
+// Maps every band lying wholly within the first rows rows not mapped yet
+void occupancy_rows_ready(occupancy_builder *builder, int rows);
+
+#endif
@@ -0,0 +1,94 @@
+#include "parallel.h"
+#include <limits.h>
+#include <uv.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+struct parallel_job {
+  int count;
+  void (*call)(void *context, int i);
+  void *context;
+  std::atomic<int> next; // The next piece nobody has taken
+  int helpers; // Pool threads inside this job, under the pool's mutex
+};
+
+/*
+ * Never freed: helpers wait on it until the process exits, and tearing it
+ * down under them at exit would be worse than leaving it.
+ */
+struct parallel_pool {
+  std::mutex mutex;
+  std::condition_variable work_ready; // A job was queued
+  std::condition_variable helper_left; // Some job's helpers dropped by one
+  std::deque<parallel_job *> jobs; // Jobs with pieces left to take
+  bool started;
+};
+
+static parallel_pool *pool = new parallel_pool();
+
+// Takes pieces of job until none are left
+static void run_pieces(parallel_job *job) {
+  for (int i = job->next++; i < job->count; i = job->next++) job->call(job->context, i);
+}
+
+// Stops job being handed to helpers, if that has not happened already
+static void retire_job(parallel_job *job) {
+  for (auto it = pool->jobs.begin(); it != pool->jobs.end(); ++it) {
+    if (*it == job) {
+      pool->jobs.erase(it);
+      return;
+    }
+  }
+}
+
+static void helper_main(void *arg) {
+  std::unique_lock<std::mutex> lock(pool->mutex);
+  for (;;) {
+    pool->work_ready.wait(lock, [] { return !pool->jobs.empty(); });
+    parallel_job *job = pool->jobs.front();
+    job->helpers++;
+
+    lock.unlock();
+    run_pieces(job);
+    lock.lock();
+
+    retire_job(job);
+    job->helpers--;
+    pool->helper_left.notify_all();
+  }
+}
+
+// Under the pool's mutex. Helpers that fail to start are simply left out.
+static void start_pool() {
+  pool->started = true;
+  int helpers = parallel_thread_count(INT_MAX) - 1;
+  for (int i = 0; i < helpers; i++) {
+    uv_thread_t thread;
+    if (uv_thread_create(&thread, helper_main, nullptr) != 0) break;
+  }
+}
+
+void parallel_run(int count, void (*call)(void *context, int i), void *context) {
+  parallel_job job;
+  job.count = count;
+  job.call = call;
+  job.context = context;
+  job.next = 0;
+  job.helpers = 0;
+
+  {
+    std::lock_guard<std::mutex> lock(pool->mutex);
+    if (!pool->started) start_pool();
+    pool->jobs.push_back(&job);
+  }
+  pool->work_ready.notify_all();
+
+  run_pieces(&job);
+
+  // Every piece is taken; wait out the helpers still finishing theirs
+  std::unique_lock<std::mutex> lock(pool->mutex);
+  retire_job(&job);
+  pool->helper_left.wait(lock, [&job] { return job.helpers == 0; });
+}
@@ -0,0 +1,43 @@
+#ifndef NODE_GIFBLOBBER_SRC_PARALLEL_H
+#define NODE_GIFBLOBBER_SRC_PARALLEL_H
+
+#include <thread>
+
+/*
+ * Threads worth using for count independent pieces of work: one per core,
+ * but never more than there is work for.
+ */
+static inline int parallel_thread_count(int count) {
+  int cores = (int)std::thread::hardware_concurrency();
+  if (cores < 1) cores = 1;
+  return count < cores ? count : cores;
+}
+
+/*
+ * Calls call(context, i) for every i in [0, count) on the shared pool, the
+ * caller's thread included, and returns once all have finished. The pool
+ * is started on first use with a helper per core but one, and is shared
+ * by every job in the process, so concurrent jobs queue for it rather than
+ * adding threads of their own. If no helper could be started the caller
+ * does all the work.
+ */
+void parallel_run(int count, void (*call)(void *context, int i), void *context);
+
+/*
+ * Calls body(i) for every i in [0, count), spreading the calls over the
+ * shared pool. Pieces are handed out one at a time, so uneven ones balance
+ * themselves. Returns once all have finished.
+ */
+template <typename Body>
+void parallel_for(int count, const Body &body) {
+  if (parallel_thread_count(count) <= 1) {
+    for (int i = 0; i < count; i++) body(i);
+    return;
+  }
+
+  parallel_run(count, [](void *context, int i) {
+    (*(const Body *)context)(i);
+  }, (void *)&body);
+}
+
+#endif
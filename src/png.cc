@@ -0,0 +1,104 @@
+#include "png.h"
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+static const unsigned char PNG_SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+static unsigned char *put_u32(unsigned char *at, uint32_t value) {
+  at[0] = (unsigned char)(value >> 24);
+  at[1] = (unsigned char)(value >> 16);
+  at[2] = (unsigned char)(value >> 8);
+  at[3] = (unsigned char)value;
+  return at + 4;
+}
+
+/*
+ * Writes a chunk whose data is already in place after room for its length
+ * and type, and returns where the next one goes.
+ */
+static unsigned char *finish_chunk(unsigned char *chunk, const char *type, size_t data_length) {
+  put_u32(chunk, (uint32_t)data_length);
+  memcpy(chunk + 4, type, 4);
+  uLong crc = crc32(0, chunk + 4, (uInt)(4 + data_length));
+  return put_u32(chunk + 8 + data_length, (uint32_t)crc);
+}
+
+unsigned char *encode_indexed_png(const unsigned char *indices, int width, int height,
+                                  const uint8_t *palette, int palette_size, size_t *length) {
+  // Every row starts with its filter type, fed to deflate ahead of the
+  // row itself. Palette images compress best unfiltered.
+  static const unsigned char no_filter = 0;
+  size_t raw_length = ((size_t)width + 1) * height;
+
+  int alpha_count = 0; // tRNS can stop after the last translucent entry
+  for (int i = 0; i < palette_size; i++) {
+    if (palette[4*i + 3] != 0xff) alpha_count = i + 1;
+  }
+
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+    return nullptr;
+  }
+  size_t compressed_bound = deflateBound(&stream, (uLong)raw_length);
+
+  size_t chunk_overhead = 12;
+  size_t capacity = sizeof(PNG_SIGNATURE) + (chunk_overhead + 13) + (chunk_overhead + 3 * palette_size)
+                  + (chunk_overhead + alpha_count) + (chunk_overhead + compressed_bound) + chunk_overhead;
+  unsigned char *png = (unsigned char *)malloc(capacity);
+  if (!png) {
+    deflateEnd(&stream);
+    return nullptr;
+  }
+
+  unsigned char *at = png;
+  memcpy(at, PNG_SIGNATURE, sizeof(PNG_SIGNATURE));
+  at += sizeof(PNG_SIGNATURE);
+
+  unsigned char *data = at + 8;
+  put_u32(data, width);
+  put_u32(data + 4, height);
+  data[8] = 8; // Bit depth
+  data[9] = 3; // Indexed color
+  data[10] = 0; // Deflate
+  data[11] = 0; // Adaptive filtering
+  data[12] = 0; // Not interlaced
+  at = finish_chunk(at, "IHDR", 13);
+
+  data = at + 8;
+  for (int i = 0; i < palette_size; i++) memcpy(data + 3*i, palette + 4*i, 3);
+  at = finish_chunk(at, "PLTE", 3 * palette_size);
+
+  if (alpha_count) {
+    data = at + 8;
+    for (int i = 0; i < alpha_count; i++) data[i] = palette[4*i + 3];
+    at = finish_chunk(at, "tRNS", alpha_count);
+  }
+
+  stream.next_out = at + 8;
+  stream.avail_out = (uInt)compressed_bound;
+  int result = Z_OK;
+  for (int y = 0; y < height && result == Z_OK; y++) {
+    stream.next_in = (Bytef *)&no_filter;
+    stream.avail_in = 1;
+    result = deflate(&stream, Z_NO_FLUSH);
+    if (result != Z_OK) break;
+    stream.next_in = (Bytef *)(indices + (size_t)width * y);
+    stream.avail_in = (uInt)width;
+    result = deflate(&stream, Z_NO_FLUSH);
+  }
+  if (result == Z_OK) result = deflate(&stream, Z_FINISH);
+  size_t compressed_length = stream.total_out;
+  deflateEnd(&stream);
+  if (result != Z_STREAM_END) {
+    free(png);
+    return nullptr;
+  }
+  at = finish_chunk(at, "IDAT", compressed_length);
+
+  at = finish_chunk(at, "IEND", 0);
+
+  *length = at - png;
+  return png;
+}
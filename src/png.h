@@ -0,0 +1,17 @@
+#ifndef NODE_GIFBLOBBER_SRC_PNG_H
+#define NODE_GIFBLOBBER_SRC_PNG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Encodes width*height palette indices as an 8-bit indexed PNG, with
+ * PLTE and, where any of its colors are not opaque, tRNS chunks for the
+ * first palette_size entries of palette (R, G, B, A bytes per entry).
+ * Returns the malloc'd file and sets *length, or returns nullptr if
+ * memory ran out.
+ */
+unsigned char *encode_indexed_png(const unsigned char *indices, int width, int height,
+                                  const uint8_t *palette, int palette_size, size_t *length);
+
+#endif
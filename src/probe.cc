@@ -0,0 +1,73 @@
+#include <node_api.h>
+#include <limits.h>
+#include "image.h"
+#include "macros.h"
+
+/*
+ * Reads the screen descriptor and walks the records of a GIF without
+ * decompressing any image data. Runs synchronously since only headers and
+ * sub-block lengths are touched.
+ */
+napi_value probe(napi_env env, napi_callback_info cbinfo) {
+  napi_status status;
+  const char *error = nullptr;
+  const char *invalid_arguments_error = "invalid argument types";
+  size_t argc = 1;
+  napi_value argv[1];
+  napi_value cbinfo_this;
+  void *cbinfo_data;
+  napi_value result = nullptr;
+  napi_value value;
+  gif_info info;
+  int gif_error;
+
+  status = napi_get_cb_info(env, cbinfo, &argc, argv, &cbinfo_this, &cbinfo_data);
+  if (status != napi_ok) goto out;
+  if (argc < 1) {
+    error = "Wrong number of arguments.";
+    goto out;
+  }
+
+  {
+    REQUIRE_ARGUMENT_BUFFER(0, gif, gif_length);
+
+    gif_error = scan_gif((const unsigned char *)gif, gif_length, INT_MAX, &info);
+    if (gif_error) {
+      napi_value exception;
+      status = create_gif_error(env, gif_error, &exception);
+      if (status == napi_ok) napi_throw(env, exception);
+      goto out;
+    }
+  }
+
+  status = napi_create_object(env, &result);
+  if (status != napi_ok) goto out;
+
+#define SET_INT_PROPERTY(NAME, VALUE) \
+  status = napi_create_int32(env, VALUE, &value); \
+  if (status != napi_ok) goto out; \
+  status = napi_set_named_property(env, result, NAME, value); \
+  if (status != napi_ok) goto out;
+
+  SET_INT_PROPERTY("width", info.width);
+  SET_INT_PROPERTY("height", info.height);
+  SET_INT_PROPERTY("frameCount", (int)info.frames.size());
+  SET_INT_PROPERTY("background", info.background);
+#undef SET_INT_PROPERTY
+
+  // The global color table as packed RGB triples, or null if there is none
+  if (info.color_map) {
+    status = napi_create_buffer_copy(env, 3 * info.color_count, info.color_map, nullptr, &value);
+  } else {
+    status = napi_get_null(env, &value);
+  }
+  if (status != napi_ok) goto out;
+  status = napi_set_named_property(env, result, "palette", value);
+  if (status != napi_ok) goto out;
+
+out:
+  if (error) {
+    napi_throw_error(env, NULL, error);
+  }
+  return result;
+}
@@ -0,0 +1,459 @@
+#include <node_api.h>
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+#include "image.h"
+#include "macros.h"
+#include "mercator.h"
+#include "parallel.h"
+#include "stretch.h"
+
+// Tiles are handed to JS in batches of about this many pixels
+#define PYRAMID_BATCH_PIXELS (4096*4096)
+
+// Batches rendered ahead of the sink before the worker waits for it
+#define PYRAMID_QUEUED_BATCHES 2
+
+#define PYRAMID_MAX_ZOOM 30
+#define PYRAMID_MAX_TILE_SIZE 4096
+
+struct pyramid_tile {
+  int z;
+  int x;
+  int y;
+  void *pixels; // tile_size*tile_size in the stretch's format, malloc'd until handed to JS
+  long long visible_pixels; // How many of them show
+};
+
+struct pyramid_batch {
+  std::vector<pyramid_tile> tiles;
+  size_t tile_bytes;
+  const char *error;
+  bool last; // Nothing follows; tiles is empty
+};
+
+struct pyramid_baton {
+  napi_async_work work;
+  napi_threadsafe_function sink;
+  napi_ref source_buffer_ref;
+  napi_ref row_starts_buffer_ref;
+  napi_ref occupancy_buffer_ref;
+  napi_ref unfiltered_palette_buffer_ref;
+  napi_ref filtered_palette_buffer_ref;
+
+  // The source, palettes and filtering for every tile's stretch
+  stretch_baton source;
+
+  int min_zoom;
+  int max_zoom;
+  int tile_size;
+
+  // Where the image lies in the world, as fractions of its width and height.
+  // With Web Mercator tiles top and bottom follow from the latitudes.
+  double left;
+  double top;
+  double right;
+  double bottom;
+};
+
+static pyramid_batch *new_batch(pyramid_baton *baton) {
+  pyramid_batch *batch = new pyramid_batch();
+  batch->tile_bytes = (size_t)baton->tile_size*baton->tile_size*stretch_pixel_bytes(baton->source.format);
+  batch->error = nullptr;
+  batch->last = false;
+  return batch;
+}
+
+static void free_batch(pyramid_batch *batch) {
+  for (size_t i = 0; i < batch->tiles.size(); i++) free(batch->tiles[i].pixels);
+  delete batch;
+}
+
+/*
+ * With Web Mercator tiles, the source row at a fraction of the way down
+ * the world.
+ */
+static double world_source_row(pyramid_baton *baton, double fraction) {
+  double latitude = mercator_latitude(M_PI * (1 - 2*fraction));
+  return (latitude - baton->source.north) * baton->source.source_height / (baton->source.south - baton->source.north);
+}
+
+/*
+ * Renders the tiles of a batch, spread over the cores. Returns false,
+ * with nothing left allocated, if memory ran out.
+ */
+static bool render_tiles(pyramid_baton *baton, pyramid_batch *batch) {
+  int tile_size = baton->tile_size;
+  bool complete = true;
+
+  for (size_t i = 0; i < batch->tiles.size(); i++) {
+    batch->tiles[i].pixels = calloc(batch->tile_bytes, 1);
+    if (!batch->tiles[i].pixels) complete = false;
+  }
+  if (!complete) {
+    for (size_t i = 0; i < batch->tiles.size(); i++) {
+      free(batch->tiles[i].pixels);
+      batch->tiles[i].pixels = nullptr;
+    }
+    return false;
+  }
+
+  parallel_for((int)batch->tiles.size(), [baton, batch, tile_size](int i) {
+    pyramid_tile &tile = batch->tiles[i];
+    double tiles_across = ldexp(1.0, tile.z);
+    double x_scale = baton->source.source_width / (baton->right - baton->left);
+    double y_scale = baton->source.source_height / (baton->bottom - baton->top);
+
+    stretch_baton stretch = baton->source;
+    stretch.source_left = (tile.x / tiles_across - baton->left) * x_scale;
+    stretch.source_right = ((tile.x + 1) / tiles_across - baton->left) * x_scale;
+    if (baton->source.mercator) {
+      stretch.source_top = world_source_row(baton, tile.y / tiles_across);
+      stretch.source_bottom = world_source_row(baton, (tile.y + 1) / tiles_across);
+    } else {
+      stretch.source_top = (tile.y / tiles_across - baton->top) * y_scale;
+      stretch.source_bottom = ((tile.y + 1) / tiles_across - baton->top) * y_scale;
+    }
+    stretch.result_width = tile_size;
+    stretch.result_height = tile_size;
+    stretch.dest_pixels = tile.pixels;
+    stretch.single_band = true; // The tiles already share out the pool
+    render_stretch(&stretch);
+    tile.visible_pixels = stretch.visible_pixels;
+  });
+  return true;
+}
+
+/*
+ * Queues a batch for the sink, waiting while enough are already queued.
+ * Returns false if the sink is going away, in which case the batch is
+ * freed here.
+ */
+static bool send_batch(pyramid_baton *baton, pyramid_batch *batch) {
+  if (napi_call_threadsafe_function(baton->sink, batch, napi_tsfn_blocking) != napi_ok) {
+    free_batch(batch);
+    return false;
+  }
+  return true;
+}
+
+/*
+ * The first and last tile along one axis at a zoom level that the image
+ * reaches into. Returns false if it misses the world altogether.
+ */
+static bool tile_span(double from, double to, int tiles_across, int *first, int *last) {
+  if (to <= 0 || from >= 1) return false;
+  *first = from <= 0 ? 0 : (int)floor(from * tiles_across);
+  *last = to >= 1 ? tiles_across - 1 : (int)ceil(to * tiles_across) - 1;
+  return *first <= *last;
+}
+
+static void pyramid_execute(napi_env env, void *data) {
+  pyramid_baton *baton = (pyramid_baton *)data;
+  size_t tiles_per_batch = PYRAMID_BATCH_PIXELS / ((size_t)baton->tile_size*baton->tile_size);
+  if (tiles_per_batch < 1) tiles_per_batch = 1;
+
+  pyramid_batch *batch = new_batch(baton);
+
+  for (int z = baton->min_zoom; z <= baton->max_zoom; z++) {
+    int tiles_across = 1 << z;
+    int first_x, last_x, first_y, last_y;
+    if (!tile_span(baton->left, baton->right, tiles_across, &first_x, &last_x)) continue;
+    if (!tile_span(baton->top, baton->bottom, tiles_across, &first_y, &last_y)) continue;
+
+    for (int y = first_y; y <= last_y; y++) {
+      for (int x = first_x; x <= last_x; x++) {
+        batch->tiles.push_back(pyramid_tile{z, x, y, nullptr, 0});
+        if (batch->tiles.size() < tiles_per_batch) continue;
+
+        if (!render_tiles(baton, batch)) goto out_of_memory;
+        if (!send_batch(baton, batch)) goto out;
+        batch = new_batch(baton);
+      }
+    }
+  }
+
+  if (!batch->tiles.empty()) {
+    if (!render_tiles(baton, batch)) goto out_of_memory;
+    if (!send_batch(baton, batch)) goto out;
+    batch = new_batch(baton);
+  }
+  batch->last = true;
+  send_batch(baton, batch);
+  goto out;
+
+out_of_memory:
+  batch->tiles.clear();
+  batch->error = "Out of memory";
+  send_batch(baton, batch);
+
+out:
+  napi_release_threadsafe_function(baton->sink, napi_tsfn_release);
+}
+
+/*
+ * On the JS thread, calls sink(null, tiles) for a batch, sink(null, null)
+ * once all have been sent, or sink(err) if rendering failed.
+ */
+static void pyramid_call_sink(napi_env env, napi_value sink, void *context, void *data) {
+  pyramid_batch *batch = (pyramid_batch *)data;
+  napi_status status;
+  napi_value args[2];
+  napi_value result;
+
+  if (!env) goto out;
+
+  if (batch->error) {
+    napi_value message;
+    status = napi_create_string_utf8(env, batch->error, NAPI_AUTO_LENGTH, &message);
+    if (status != napi_ok) goto out;
+    status = napi_create_error(env, nullptr, message, &args[0]);
+    if (status != napi_ok) goto out;
+    napi_call_function(env, sink, sink, 1, args, &result);
+    goto out;
+  }
+
+  status = napi_get_null(env, &args[0]);
+  if (status != napi_ok) goto out;
+
+  if (batch->last) {
+    args[1] = args[0];
+  } else {
+    status = napi_create_array_with_length(env, batch->tiles.size(), &args[1]);
+    if (status != napi_ok) goto out;
+
+    for (size_t i = 0; i < batch->tiles.size(); i++) {
+      pyramid_tile &tile = batch->tiles[i];
+      napi_value tile_object, z, x, y, pixels, covered, empty;
+      status = napi_create_object(env, &tile_object);
+      if (status != napi_ok) goto out;
+      status = napi_create_int32(env, tile.z, &z);
+      if (status != napi_ok) goto out;
+      status = napi_create_int32(env, tile.x, &x);
+      if (status != napi_ok) goto out;
+      status = napi_create_int32(env, tile.y, &y);
+      if (status != napi_ok) goto out;
+      status = create_owned_buffer(env, (void **)&tile.pixels, batch->tile_bytes, &pixels);
+      if (status != napi_ok) goto out;
+      status = napi_create_int64(env, tile.visible_pixels, &covered);
+      if (status != napi_ok) goto out;
+      status = napi_get_boolean(env, tile.visible_pixels == 0, &empty);
+      if (status != napi_ok) goto out;
+      status = napi_set_named_property(env, tile_object, "z", z);
+      if (status != napi_ok) goto out;
+      status = napi_set_named_property(env, tile_object, "x", x);
+      if (status != napi_ok) goto out;
+      status = napi_set_named_property(env, tile_object, "y", y);
+      if (status != napi_ok) goto out;
+      status = napi_set_named_property(env, tile_object, "pixels", pixels);
+      if (status != napi_ok) goto out;
+      status = napi_set_named_property(env, tile_object, "covered", covered);
+      if (status != napi_ok) goto out;
+      status = napi_set_named_property(env, tile_object, "empty", empty);
+      if (status != napi_ok) goto out;
+      status = napi_set_element(env, args[1], (uint32_t)i, tile_object);
+      if (status != napi_ok) goto out;
+    }
+  }
+
+  napi_call_function(env, sink, sink, 2, args, &result);
+
+out:
+  free_batch(batch);
+}
+
+static void pyramid_complete(napi_env env, napi_status status, void *data) {
+  pyramid_baton *baton = (pyramid_baton *)data;
+
+  napi_delete_async_work(env, baton->work);
+  napi_delete_reference(env, baton->source_buffer_ref);
+  if (baton->row_starts_buffer_ref) napi_delete_reference(env, baton->row_starts_buffer_ref);
+  if (baton->occupancy_buffer_ref) napi_delete_reference(env, baton->occupancy_buffer_ref);
+  napi_delete_reference(env, baton->unfiltered_palette_buffer_ref);
+  napi_delete_reference(env, baton->filtered_palette_buffer_ref);
+
+  delete baton;
+}
+
+/*
+ * renderPyramid(source, width, height, unfiltered_palette, filtered_palette,
+ *               filtered, min_zoom, max_zoom, tile_size,
+ *               left, top, right, bottom, sink[, row_starts[, latitudes[, reduction[, format[, occupancy]]]]])
+ *
+ * Stretches the image onto every tile of zoom levels [min_zoom, max_zoom]
+ * that it reaches into, the world being one tile at zoom 0 and the image
+ * covering [left, right) x [top, bottom) of it. With row_starts the source
+ * is run-length encoded. Given latitudes, { north, south }, the tiles are
+ * Web Mercator and the image's top and bottom are where those fall.
+ * reduction, format and occupancy are as for stretch. Tiles go to
+ * sink(null, [{ z, x, y, pixels, covered, empty }, ...]) in batches, followed
+ * by sink(null, null); covered and empty are as stretch reports them.
+ */
+napi_value render_pyramid(napi_env env, napi_callback_info cbinfo) {
+  napi_status status;
+  napi_async_work work = nullptr;
+  napi_threadsafe_function sink = nullptr;
+  napi_ref source_buffer_ref = nullptr;
+  napi_ref row_starts_buffer_ref = nullptr;
+  napi_ref occupancy_buffer_ref = nullptr;
+  napi_ref unfiltered_palette_buffer_ref = nullptr;
+  napi_ref filtered_palette_buffer_ref = nullptr;
+
+  const char *error = nullptr;
+  const char *invalid_arguments_error = "invalid argument types";
+  napi_value cbinfo_this;
+  void *cbinfo_data;
+  size_t argc = 19;
+  napi_value argv[19];
+  void *row_starts = nullptr;
+  size_t row_starts_length = 0;
+  bool run_length = false;
+  napi_value description;
+  stretch_baton baton_source = stretch_baton();
+
+  pyramid_baton *baton = nullptr;
+
+  status = napi_get_cb_info(env, cbinfo, &argc, argv, &cbinfo_this, &cbinfo_data);
+  if (status != napi_ok) goto out;
+  if (argc < 14) {
+    error = "Wrong number of arguments.";
+    goto out;
+  }
+
+  {
+    REQUIRE_ARGUMENT_BUFFER_REF(0, source_buffer, source_buffer_length, source_buffer_ref);
+    REQUIRE_ARGUMENT_INTEGER(1, source_width);
+    REQUIRE_ARGUMENT_INTEGER(2, source_height);
+    REQUIRE_ARGUMENT_BUFFER_REF(3, unfiltered_palette, unfiltered_palette_length, unfiltered_palette_buffer_ref);
+    REQUIRE_ARGUMENT_BUFFER_REF(4, filtered_palette, filtered_palette_length, filtered_palette_buffer_ref);
+    REQUIRE_ARGUMENT_BOOLEAN(5, filtered);
+    REQUIRE_ARGUMENT_INTEGER(6, min_zoom);
+    REQUIRE_ARGUMENT_INTEGER(7, max_zoom);
+    REQUIRE_ARGUMENT_INTEGER(8, tile_size);
+    REQUIRE_ARGUMENT_DOUBLE(9, left);
+    REQUIRE_ARGUMENT_DOUBLE(10, top);
+    REQUIRE_ARGUMENT_DOUBLE(11, right);
+    REQUIRE_ARGUMENT_DOUBLE(12, bottom);
+
+    napi_valuetype row_starts_type = napi_undefined;
+    if (argc > 14) {
+      status = napi_typeof(env, argv[14], &row_starts_type);
+      if (status != napi_ok) goto out;
+    }
+    if (row_starts_type != napi_undefined && row_starts_type != napi_null) {
+      REQUIRE_ARGUMENT_BUFFER_REF(14, row_starts_buffer, row_starts_buffer_length, row_starts_buffer_ref);
+      row_starts = row_starts_buffer;
+      row_starts_length = row_starts_buffer_length;
+      run_length = true;
+    }
+
+    if (filtered_palette_length != 256*4 || unfiltered_palette_length != 256*4) {
+      error = "Palette buffers must be of length 256";
+      goto out;
+    }
+    error = stretch_source_error(source_buffer, source_buffer_length, row_starts, row_starts_length,
+                                 source_width, source_height, run_length);
+    if (error) goto out;
+    if (min_zoom < 0 || max_zoom < min_zoom || max_zoom > PYRAMID_MAX_ZOOM) {
+      error = "Zoom levels must satisfy 0 <= minZoom <= maxZoom <= 30";
+      goto out;
+    }
+    if (tile_size <= 0 || tile_size > PYRAMID_MAX_TILE_SIZE) {
+      error = "Tile size must be between 1 and 4096";
+      goto out;
+    }
+    if (argc > 15) {
+      error = read_stretch_latitudes(env, argv[15], &baton_source);
+      if (error) goto out;
+      if (baton_source.mercator) {
+        top = (1 - mercator_y(baton_source.north) / M_PI) / 2;
+        bottom = (1 - mercator_y(baton_source.south) / M_PI) / 2;
+      }
+    }
+    if (argc > 16) {
+      error = read_stretch_reduction(env, argv[16], &baton_source);
+      if (error) goto out;
+    }
+    if (argc > 17) {
+      error = read_stretch_format(env, argv[17], &baton_source);
+      if (error) goto out;
+    }
+    if (argc > 18) {
+      error = read_stretch_occupancy(env, argv[18], source_width, source_height, &baton_source, &occupancy_buffer_ref);
+      if (error) goto out;
+    }
+    if (!(right > left) || !(bottom > top) || !isfinite(right - left) || !isfinite(bottom - top)) {
+      error = "Bounds must have positive width and height";
+      goto out;
+    }
+
+    status = napi_create_string_utf8(env, "gif pyramid", NAPI_AUTO_LENGTH, &description);
+    if (status != napi_ok) goto out;
+
+    status = napi_create_threadsafe_function(env, argv[13], nullptr, description, PYRAMID_QUEUED_BATCHES, 1,
+        nullptr, nullptr, nullptr, pyramid_call_sink, &sink);
+    if (status != napi_ok) {
+      error = "Sink must be a function";
+      goto out;
+    }
+
+    baton = new pyramid_baton();
+
+    status = napi_create_async_work(env, nullptr, description, pyramid_execute, pyramid_complete, baton, &work);
+    if (status != napi_ok) goto out;
+
+    baton->source = baton_source;
+    baton->source.source_width = source_width;
+    baton->source.source_height = source_height;
+    if (run_length) {
+      baton->source.source_runs = (const rle_run *)source_buffer;
+      baton->source.source_row_starts = (const uint32_t *)row_starts;
+    } else {
+      baton->source.source_pixels = (unsigned char *)source_buffer;
+    }
+    baton->source.filtered = filtered;
+    baton->source.filtered_palette = (int *)filtered_palette;
+    baton->source.unfiltered_palette = (int *)unfiltered_palette;
+    baton->min_zoom = min_zoom;
+    baton->max_zoom = max_zoom;
+    baton->tile_size = tile_size;
+    baton->left = left;
+    baton->top = top;
+    baton->right = right;
+    baton->bottom = bottom;
+    baton->sink = sink;
+    baton->source_buffer_ref = source_buffer_ref;
+    baton->row_starts_buffer_ref = row_starts_buffer_ref;
+    baton->occupancy_buffer_ref = occupancy_buffer_ref;
+    baton->unfiltered_palette_buffer_ref = unfiltered_palette_buffer_ref;
+    baton->filtered_palette_buffer_ref = filtered_palette_buffer_ref;
+    baton->work = work;
+  }
+
+  status = napi_queue_async_work(env, work);
+  if (status != napi_ok) goto out;
+
+  baton = nullptr;
+  work = nullptr;
+  sink = nullptr;
+  source_buffer_ref = nullptr;
+  row_starts_buffer_ref = nullptr;
+  occupancy_buffer_ref = nullptr;
+  unfiltered_palette_buffer_ref = nullptr;
+  filtered_palette_buffer_ref = nullptr;
+
+out:
+  if (sink) napi_release_threadsafe_function(sink, napi_tsfn_abort);
+  if (source_buffer_ref) napi_delete_reference(env, source_buffer_ref);
+  if (row_starts_buffer_ref) napi_delete_reference(env, row_starts_buffer_ref);
+  if (occupancy_buffer_ref) napi_delete_reference(env, occupancy_buffer_ref);
+  if (unfiltered_palette_buffer_ref) napi_delete_reference(env, unfiltered_palette_buffer_ref);
+  if (filtered_palette_buffer_ref) napi_delete_reference(env, filtered_palette_buffer_ref);
+  if (work) napi_delete_async_work(env, work);
+  if (baton) delete baton;
+
+  if (error) {
+    napi_throw_error(env, NULL, error);
+  }
+  return nullptr;
+}
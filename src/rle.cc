@@ -0,0 +1,94 @@
+#include "rle.h"
+#include <stdlib.h>
+#include <string.h>
+
+static inline const unsigned char *run_end(const unsigned char *at, const unsigned char *row_end) {
+  unsigned char value = *at;
+  while (++at < row_end && *at == value) {}
+  return at;
+}
+
+bool rle_encode(const unsigned char *pixels, int width, int height, rle_image *rle) {
+  rle->width = width;
+  rle->height = height;
+  rle->run_count = 0;
+  rle->runs = nullptr;
+  rle->row_starts = (uint32_t *)malloc(sizeof(uint32_t) * (height + 1));
+  if (!rle->row_starts) return false;
+
+  // Count first so the runs get exactly one allocation
+  size_t run_count = 0;
+  for (int y = 0; y < height; y++) {
+    const unsigned char *row = pixels + (size_t)y*width;
+    for (const unsigned char *at = row; at < row + width; at = run_end(at, row + width)) {
+      run_count++;
+    }
+  }
+
+  rle->runs = (rle_run *)malloc(sizeof(rle_run) * (run_count ? run_count : 1));
+  if (!rle->runs) {
+    rle_free(rle);
+    return false;
+  }
+
+  rle_run *run = rle->runs;
+  for (int y = 0; y < height; y++) {
+    rle->row_starts[y] = (uint32_t)(run - rle->runs);
+    const unsigned char *row = pixels + (size_t)y*width;
+    for (const unsigned char *at = row; at < row + width; ) {
+      const unsigned char *end = run_end(at, row + width);
+      run->value = *at;
+      run->unused = 0;
+      run->length = (uint16_t)(end - at);
+      run++;
+      at = end;
+    }
+  }
+  rle->row_starts[height] = (uint32_t)run_count;
+  rle->run_count = run_count;
+  return true;
+}
+
+void rle_expand_row(const rle_run *runs, const uint32_t *row_starts, int y, unsigned char *row) {
+  const rle_run *run = runs + row_starts[y];
+  const rle_run *end = runs + row_starts[y + 1];
+  for (; run < end; run++) {
+    memset(row, run->value, run->length);
+    row += run->length;
+  }
+}
+
+void rle_expand_span(const rle_run *runs, const uint32_t *row_starts, int y, int x1, int x2, unsigned char *row) {
+  const rle_run *run = runs + row_starts[y];
+  const rle_run *end = runs + row_starts[y + 1];
+  int x = 0;
+  for (; run < end && x + run->length <= x1; run++) x += run->length;
+  for (; run < end && x < x2; run++) {
+    int from = x > x1 ? x : x1;
+    x += run->length;
+    int to = x < x2 ? x : x2;
+    memset(row + from, run->value, to - from);
+  }
+}
+
+bool rle_is_consistent(const rle_run *runs, size_t run_count, const uint32_t *row_starts, int width, int height) {
+  if (row_starts[0] != 0 || row_starts[height] != run_count) return false;
+
+  for (int y = 0; y < height; y++) {
+    if (row_starts[y] > row_starts[y + 1]) return false;
+    long row_width = 0;
+    for (uint32_t i = row_starts[y]; i < row_starts[y + 1]; i++) {
+      row_width += runs[i].length;
+    }
+    if (row_width != width) return false;
+  }
+  return true;
+}
+
+void rle_free(rle_image *rle) {
+  free(rle->runs);
+  free(rle->row_starts);
+  rle->runs = nullptr;
+  rle->row_starts = nullptr;
+  rle->run_count = 0;
+}
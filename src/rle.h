@@ -0,0 +1,50 @@
+#ifndef NODE_GIFBLOBBER_SRC_RLE_H
+#define NODE_GIFBLOBBER_SRC_RLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct rle_run {
+  uint8_t value;
+  uint8_t unused;
+  uint16_t length; // GIF dimensions are 16 bit, so a run never needs more
+};
+
+/*
+ * An index raster stored as runs of equal pixels. Runs never cross rows;
+ * row y is runs[row_starts[y]] up to runs[row_starts[y+1]].
+ */
+struct rle_image {
+  int width;
+  int height;
+  size_t run_count;
+  rle_run *runs; // malloc'd
+  uint32_t *row_starts; // malloc'd, height+1 entries
+};
+
+/*
+ * Encodes a dense width*height raster. Returns false if memory ran out,
+ * leaving rle empty.
+ */
+bool rle_encode(const unsigned char *pixels, int width, int height, rle_image *rle);
+
+/*
+ * Writes pixels [0, width) of row y out densely.
+ */
+void rle_expand_row(const rle_run *runs, const uint32_t *row_starts, int y, unsigned char *row);
+
+/*
+ * Writes just pixels [x1, x2) of row y, to the same places in row as
+ * rle_expand_row would. The runs before x1 are stepped over, not expanded.
+ */
+void rle_expand_span(const rle_run *runs, const uint32_t *row_starts, int y, int x1, int x2, unsigned char *row);
+
+/*
+ * Whether runs and row_starts, as handed in from JS, describe exactly a
+ * width*height raster, so that they can be walked without bounds checks.
+ */
+bool rle_is_consistent(const rle_run *runs, size_t run_count, const uint32_t *row_starts, int width, int height);
+
+void rle_free(rle_image *rle);
+
+#endif
@@ -0,0 +1,130 @@
+#include "scan.h"
+#include <string.h>
+
+#define EXTENSION_INTRODUCER 0x21
+#define DESCRIPTOR_INTRODUCER 0x2c
+#define TERMINATOR_INTRODUCER 0x3b
+
+static_assert(sizeof(GifColorType) == 3, "color tables are used in place");
+
+static inline int read_word(const unsigned char *p) {
+  return p[0] | (p[1] << 8);
+}
+
+/*
+ * Steps over a run of sub-blocks starting at offset, leaving offset just
+ * past the terminating empty block. Returns the bytes of payload skipped,
+ * or -1 if the data ends first.
+ */
+static long skip_sub_blocks(const unsigned char *gif, size_t length, size_t *offset) {
+  size_t at = *offset;
+  long payload = 0;
+  for (;;) {
+    if (at >= length) return -1;
+    int block_length = gif[at];
+    at += 1 + block_length;
+    if (block_length == 0) break;
+    payload += block_length;
+  }
+  *offset = at;
+  return payload;
+}
+
+int scan_gif(const unsigned char *gif, size_t length, int max_frames, gif_info *info) {
+  info->frames.clear();
+  info->color_map = nullptr;
+  info->color_count = 0;
+
+  if (length < 6) return D_GIF_ERR_READ_FAILED;
+  if (memcmp(gif, "GIF", 3) != 0) return D_GIF_ERR_NOT_GIF_FILE;
+  if (length < 13) return D_GIF_ERR_NO_SCRN_DSCR;
+
+  info->width = read_word(gif + 6);
+  info->height = read_word(gif + 8);
+  info->background = gif[11];
+  size_t offset = 13;
+
+  if (gif[10] & 0x80) {
+    info->color_count = 1 << ((gif[10] & 0x07) + 1);
+    info->color_map = (const GifColorType *)(gif + offset);
+    offset += 3 * info->color_count;
+    if (offset > length) return D_GIF_ERR_READ_FAILED;
+  }
+
+  int disposal = DISPOSAL_UNSPECIFIED;
+  int delay = 0;
+  int transparent_color = NO_TRANSPARENT_COLOR;
+
+  while ((int)info->frames.size() < max_frames) {
+    if (offset >= length) {
+      // Plenty of writers leave off the trailer
+      if (info->frames.empty()) return D_GIF_ERR_READ_FAILED;
+      break;
+    }
+
+    int introducer = gif[offset++];
+    if (introducer == TERMINATOR_INTRODUCER) break;
+
+    if (introducer == EXTENSION_INTRODUCER) {
+      if (offset >= length) return D_GIF_ERR_READ_FAILED;
+      int label = gif[offset++];
+      if (label == GRAPHICS_EXT_FUNC_CODE && offset + 5 <= length && gif[offset] == 4) {
+        const unsigned char *block = gif + offset + 1;
+        disposal = (block[0] >> 2) & 0x07;
+        delay = read_word(block + 1);
+        transparent_color = (block[0] & 0x01) ? block[3] : NO_TRANSPARENT_COLOR;
+      }
+      if (skip_sub_blocks(gif, length, &offset) < 0) return D_GIF_ERR_READ_FAILED;
+      continue;
+    }
+
+    if (introducer != DESCRIPTOR_INTRODUCER) return D_GIF_ERR_WRONG_RECORD;
+
+    if (offset + 9 > length) return D_GIF_ERR_READ_FAILED;
+    gif_frame frame;
+    frame.left = read_word(gif + offset);
+    frame.top = read_word(gif + offset + 2);
+    frame.width = read_word(gif + offset + 4);
+    frame.height = read_word(gif + offset + 6);
+    int flags = gif[offset + 8];
+    frame.interlace = (flags & 0x40) != 0;
+    offset += 9;
+
+    frame.color_map = nullptr;
+    frame.color_count = 0;
+    if (flags & 0x80) {
+      frame.color_count = 1 << ((flags & 0x07) + 1);
+      frame.color_map = (const GifColorType *)(gif + offset);
+      offset += 3 * frame.color_count;
+    }
+
+    if (offset >= length) return D_GIF_ERR_READ_FAILED;
+    frame.min_code_size = gif[offset++];
+    frame.data_offset = offset;
+    long code_length = skip_sub_blocks(gif, length, &offset);
+    if (code_length < 0) return D_GIF_ERR_READ_FAILED;
+    frame.code_length = (size_t)code_length;
+
+    frame.disposal = disposal;
+    frame.delay = delay;
+    frame.transparent_color = transparent_color;
+    info->frames.push_back(frame);
+
+    // A Graphics Control Block only applies to the image that follows it
+    disposal = DISPOSAL_UNSPECIFIED;
+    delay = 0;
+    transparent_color = NO_TRANSPARENT_COLOR;
+  }
+
+  if (info->frames.empty()) return D_GIF_ERR_NO_IMAG_DSCR;
+  return 0;
+}
+
+void gather_codes(const unsigned char *gif, const gif_frame &frame, unsigned char *codes) {
+  const unsigned char *block = gif + frame.data_offset;
+  while (*block) {
+    memcpy(codes, block + 1, *block);
+    codes += *block;
+    block += 1 + *block;
+  }
+}
@@ -0,0 +1,52 @@
+#ifndef NODE_GIFBLOBBER_SRC_SCAN_H
+#define NODE_GIFBLOBBER_SRC_SCAN_H
+
+#include <stddef.h>
+#include <gif_lib.h>
+#include <vector>
+
+struct gif_frame {
+  int left;
+  int top;
+  int width;
+  int height;
+  bool interlace;
+
+  const GifColorType *color_map; // Local color table, or nullptr
+  int color_count;
+
+  int min_code_size;
+  size_t data_offset; // Offset of the first data sub-block's length byte
+  size_t code_length; // Bytes of LZW data once the sub-block framing is stripped
+
+  // From the Graphics Control Block preceding the image, if any
+  int disposal;
+  int delay;
+  int transparent_color;
+};
+
+struct gif_info {
+  int width;
+  int height;
+  int background;
+
+  const GifColorType *color_map; // Global color table, or nullptr
+  int color_count;
+
+  std::vector<gif_frame> frames;
+};
+
+/*
+ * Walks the records of a GIF held in memory without decompressing anything,
+ * stopping after max_frames images. Image data is skipped by its sub-block
+ * lengths alone. Returns a giflib error code, or 0.
+ */
+int scan_gif(const unsigned char *gif, size_t length, int max_frames, gif_info *info);
+
+/*
+ * Copies a frame's LZW data out of its sub-blocks into codes, which must
+ * have room for frame.code_length bytes.
+ */
+void gather_codes(const unsigned char *gif, const gif_frame &frame, unsigned char *codes);
+
+#endif
@@ -2,95 +2,128 @@
 #include <gif_lib.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <stdio.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "image.h"
+#include "macros.h"
+#include "parallel.h"
 
 #define RADAR_COLOR_COUNT 15
 
-static const int UNFILTERED_BLANK_OUT_UNTIL = 6;
-static const int FILTERED_BLANK_OUT_UNTIL = 9;
-
-
 struct slurp_baton {
   napi_async_work work; // So we can delete when we are done
   napi_ref callback;
   napi_ref gif_buffer_ref;
   
-  const char *gif_buffer;
+  const unsigned char *gif_buffer;
   size_t gif_length;
-  size_t spewed_length;
-  int status;
-  
-  int width;
-  int height;
+  std::string gif_path; // Read on the worker instead if set; gif_buffer_ref is then null
+  bool all_frames; // Whether to composite every frame rather than just the first
+  bool has_region;
+  image_region region; // The part of the screen wanted, if has_region
+  bool run_length; // Whether to hand back runs rather than a dense raster
+  int error; // giflib error code, or 0 if decoding succeeded
   
-  unsigned char *pixels;
-  uint32_t filtered_palette[256];
-  uint32_t unfiltered_palette[256];
+  decoded_image image;
+  rle_image rle;
 };
 
-int ReadMemoryGif (GifFileType *gif_file, GifByteType *buffer, int size) {
-  slurp_baton *baton = static_cast<slurp_baton *>(gif_file->UserData);
-  if (baton->spewed_length == baton->gif_length) {
-    return 0;
+/*
+ * Maps a whole file read-only. Returns a giflib error code, or 0.
+ */
+static int map_file(const char *path, const unsigned char **data, size_t *length) {
+#ifdef _WIN32
+  FILE *file = fopen(path, "rb");
+  if (!file) return D_GIF_ERR_OPEN_FAILED;
+  unsigned char *bytes = nullptr;
+  long size = -1;
+  if (fseek(file, 0, SEEK_END) == 0) size = ftell(file);
+  if (size >= 0 && fseek(file, 0, SEEK_SET) == 0) {
+    bytes = (unsigned char *)malloc(size ? size : 1);
+    if (bytes && fread(bytes, 1, size, file) != (size_t)size) {
+      free(bytes);
+      bytes = nullptr;
+    }
   }
+  fclose(file);
+  if (!bytes) return D_GIF_ERR_READ_FAILED;
+  *data = bytes;
+  *length = size;
+  return 0;
+#else
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return D_GIF_ERR_OPEN_FAILED;
 
-  size_t copy_length = baton->gif_length - baton->spewed_length;
-  if (copy_length > (size_t)size) {
-    // Trim to request
-    copy_length = (size_t)size;
+  struct stat info;
+  int error = 0;
+  if (fstat(fd, &info) != 0 || info.st_size == 0) {
+    error = D_GIF_ERR_READ_FAILED;
+  } else {
+    void *mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+      error = D_GIF_ERR_READ_FAILED;
+    } else {
+      // The scanner and LZW decoder each make one forward pass
+      madvise(mapped, info.st_size, MADV_SEQUENTIAL);
+      *data = (const unsigned char *)mapped;
+      *length = info.st_size;
+    }
   }
-
-  memcpy(buffer, baton->gif_buffer + baton->spewed_length, copy_length);
-  baton->spewed_length += copy_length;
-  return copy_length;
+  close(fd); // The mapping outlives the descriptor
+  return error;
+#endif
 }
 
-static inline int clamp(int inclusive_min, int x, int inclusive_max) {
-  return x <= inclusive_min ? inclusive_min
-       : x >= inclusive_max ? inclusive_max
-       : x;
+static void unmap_file(const unsigned char *data, size_t length) {
+#ifdef _WIN32
+  free((void *)data);
+#else
+  munmap((void *)data, length);
+#endif
 }
 
+static void decode_baton(slurp_baton *baton) {
+  if (baton->all_frames) {
+    baton->error = decode_all_frames(baton->gif_buffer, baton->gif_length, &baton->image);
+  } else {
+    baton->error = decode_first_image(baton->gif_buffer, baton->gif_length,
+        baton->has_region ? &baton->region : nullptr, &baton->image);
+  }
+
+  // The LZW dictionary points back into the dense output, so runs can only
+  // be formed once the image is complete; the dense raster goes right after
+  if (!baton->error && baton->run_length) {
+    if (!rle_encode(baton->image.pixels, baton->image.width, baton->image.height, &baton->rle)) {
+      baton->error = D_GIF_ERR_NOT_ENOUGH_MEM;
+    }
+    free(baton->image.pixels); // The occupancy map goes along with the runs
+    baton->image.pixels = nullptr;
+  }
+}
 
 void slurp_gif_execute(napi_env env, void* data)
 {
   slurp_baton *baton = (slurp_baton *)data;
 
-  baton->status = GIF_OK;
-  GifFileType *gif_file = DGifOpen(baton, ReadMemoryGif, &baton->status);
-  if (baton->status != GIF_OK) {
-    DGifCloseFile(gif_file);
-    return;
-  }
-  baton->status = DGifSlurp(gif_file);
-
-  if (baton->status != GIF_OK) {
-    DGifCloseFile(gif_file);
+  if (baton->gif_path.empty()) {
+    decode_baton(baton);
     return;
   }
 
-  if (gif_file->SColorMap) {
-    int colors = clamp(0, gif_file->SColorMap->ColorCount, 256);
-
-    for (int i = 0; i < colors; i++) {
-      GifColorType color = gif_file->SColorMap->Colors[i];
-      int alphaed = color.Red | (color.Green<<8) | (color.Blue<<16) | 0x40000000;
-      baton->unfiltered_palette[i] = i <= UNFILTERED_BLANK_OUT_UNTIL ? 0 : alphaed;
-      baton->filtered_palette[i] = i <= FILTERED_BLANK_OUT_UNTIL ? 0 : alphaed;
-    }
-  }
-
-  baton->width = gif_file->SWidth;
-  baton->height = gif_file->SHeight;
-  int pixel_count = gif_file->SWidth * gif_file->SHeight;
-  unsigned char *filtered = new unsigned char[pixel_count];
-  unsigned char *unfiltered = gif_file->SavedImages[0].RasterBits;
-  for (int i = 0; i < pixel_count; i++) {
-    filtered[i] = unfiltered[i];
-  }
-
-  DGifCloseFile(gif_file);
-
-  baton->pixels = filtered;
+  baton->error = map_file(baton->gif_path.c_str(), &baton->gif_buffer, &baton->gif_length);
+  if (baton->error) return;
+  decode_baton(baton);
+  unmap_file(baton->gif_buffer, baton->gif_length);
+  baton->gif_buffer = nullptr;
 }
 
 void slurp_gif_complete(napi_env env, napi_status status, void* data)
@@ -99,78 +132,47 @@ void slurp_gif_complete(napi_env env, napi_status status, void* data)
   
   napi_value cb;
   status = napi_get_reference_value(env, baton->callback, &cb);
-
-  napi_value err;
-  napi_value width;
-  napi_value height;
-  napi_value pixel_buffer;
-  napi_value unfiltered_palette_buffer;
-  napi_value filtered_palette_buffer;
-  
-  void *buffer_data;
-  size_t data_size;
-
-  napi_value args[6];
-  napi_value result;
-
-  if (status != napi_ok) goto out;
-  
-  status = napi_get_null(env, &err);
   if (status != napi_ok) goto out;
 
-  status = napi_create_int32(env, baton->width, &width);
-  if (status != napi_ok) goto out;
-  
-  status = napi_create_int32(env, baton->height, &height);
-  if (status != napi_ok) goto out;
-  
-  // Pixel buffer
-  data_size = baton->width * baton->height;
-  status = napi_create_buffer(env, data_size, &buffer_data, &pixel_buffer);
-  if (status != napi_ok) goto out;
-  memcpy(buffer_data, baton->pixels, data_size);
-  
-  // Unfiltered palette buffer
-  status = napi_create_buffer(env, 256*4, &buffer_data, &unfiltered_palette_buffer);
-  if (status != napi_ok) goto out;
-  memcpy(buffer_data, baton->unfiltered_palette, 256*4);
-  
-  // Filtered palette buffer
-  status = napi_create_buffer(env, 256*4, &buffer_data, &filtered_palette_buffer);
-  if (status != napi_ok) goto out;
-  memcpy(buffer_data, baton->filtered_palette, 256*4);
-  
-  args[0] = err;
-  args[1] = width;
-  args[2] = height;
-  args[3] = pixel_buffer;
-  args[4] = unfiltered_palette_buffer;
-  args[5] = filtered_palette_buffer;
-
-  napi_call_function(env, cb, cb, 6, args, &result);
-  
+  if (baton->all_frames) {
+    call_frames_callback(env, cb, baton->error, &baton->image);
+  } else if (baton->run_length) {
+    call_rle_callback(env, cb, baton->error, &baton->image, &baton->rle);
+  } else {
+    call_image_callback(env, cb, baton->error, &baton->image);
+  }
   
 out:
-  delete[] baton->pixels;
+  free_image(&baton->image);
+  rle_free(&baton->rle);
   napi_delete_async_work(env, baton->work);
   napi_delete_reference(env, baton->callback);
-  napi_delete_reference(env, baton->gif_buffer_ref);
+  if (baton->gif_buffer_ref) napi_delete_reference(env, baton->gif_buffer_ref);
   
   delete baton;
 }
 
-napi_value slurp(napi_env env, napi_callback_info cbinfo) {
+/*
+ * slurp(buffer, [options], cb), or with from_file, slurpFile(path, [options], cb)
+ */
+static napi_value queue_slurp(napi_env env, napi_callback_info cbinfo, bool all_frames, bool from_file) {
   napi_status status;
   napi_async_work work = nullptr;
   napi_ref callback_ref = nullptr;
   napi_ref buffer_ref = nullptr;
   
-  size_t argc = 2;
-  napi_value argv[2];
+  const char *error = nullptr;
+  const char *invalid_arguments_error = "invalid argument types";
+  size_t argc = 3;
+  napi_value argv[3];
   napi_value cbinfo_this;
   void *cbinfo_data;
   void *gif_bytes;
   size_t gif_byte_count;
+  int32_t region_left = 0, region_top = 0, region_right = INT_MAX, region_bottom = INT_MAX;
+  int32_t region_rows = INT_MAX;
+  bool has_region = false;
+  bool run_length = false;
   
   slurp_baton *baton = nullptr;
 
@@ -183,18 +185,55 @@ napi_value slurp(napi_env env, napi_callback_info cbinfo) {
   if (status != napi_ok) goto out;
   
   buffer = argv[0];
-  cb = argv[1];
+  cb = argv[argc < 3 ? 1 : 2];
+
+  // slurp(buffer, { rows } or { left, top, right, bottom }, cb) keeps only
+  // part of the screen. { rle: true } gives runs instead of a dense raster.
+  if (argc >= 3 && !all_frames) {
+    napi_value options = argv[1];
+    OPTIONAL_PROPERTY_INTEGER(options, "left", region_left);
+    OPTIONAL_PROPERTY_INTEGER(options, "top", region_top);
+    OPTIONAL_PROPERTY_INTEGER(options, "right", region_right);
+    OPTIONAL_PROPERTY_INTEGER(options, "bottom", region_bottom);
+    OPTIONAL_PROPERTY_INTEGER(options, "rows", region_rows);
+    OPTIONAL_PROPERTY_BOOLEAN(options, "rle", run_length);
+    if (region_rows < region_bottom) region_bottom = region_rows;
+    has_region = true;
+  }
   
-  status = napi_get_buffer_info(env, buffer, &gif_bytes, &gif_byte_count);
+  if (from_file) {
+    size_t path_length;
+    status = napi_get_value_string_utf8(env, buffer, nullptr, 0, &path_length);
+    if (status != napi_ok) {
+      error = invalid_arguments_error;
+      goto out;
+    }
+    baton->gif_path.resize(path_length + 1);
+    status = napi_get_value_string_utf8(env, buffer, &baton->gif_path[0], path_length + 1, &path_length);
+    if (status != napi_ok) goto out;
+    baton->gif_path.resize(path_length);
+    if (baton->gif_path.empty()) {
+      error = "Path must not be empty";
+      goto out;
+    }
+    gif_bytes = nullptr;
+    gif_byte_count = 0;
+  } else {
+    status = napi_get_buffer_info(env, buffer, &gif_bytes, &gif_byte_count);
+    if (status != napi_ok) {
+      error = invalid_arguments_error;
+      goto out;
+    }
+
+    status = napi_create_reference(env, buffer, 1, &buffer_ref);
+    if (status != napi_ok) goto out;
+  }
   
   status = napi_create_string_utf8(env, "gif slurp", NAPI_AUTO_LENGTH, &slurp_description);
   if (status != napi_ok) goto out;
   
   status = napi_create_reference(env, cb, 1, &callback_ref);
   if (status != napi_ok) goto out;
-  
-  status = napi_create_reference(env, buffer, 1, &buffer_ref);
-  if (status != napi_ok) goto out;
 
   status = napi_create_async_work(env, nullptr, slurp_description, slurp_gif_execute, slurp_gif_complete, baton, &work); 
   if (status != napi_ok) goto out;
@@ -202,13 +241,18 @@ napi_value slurp(napi_env env, napi_callback_info cbinfo) {
   baton->work = work;
   baton->callback = callback_ref;
   baton->gif_buffer_ref = buffer_ref;
-  baton->gif_buffer = (const char *)gif_bytes;
+  baton->gif_buffer = (const unsigned char *)gif_bytes;
   baton->gif_length = gif_byte_count;
-  baton->spewed_length = 0;
-  baton->status = 0;
-  baton->width = 0;
-  baton->height = 0;
-  baton->pixels = nullptr;
+  baton->all_frames = all_frames;
+  baton->has_region = has_region;
+  baton->run_length = run_length;
+  baton->region.left = region_left;
+  baton->region.top = region_top;
+  baton->region.right = region_right;
+  baton->region.bottom = region_bottom;
+  baton->error = 0;
+  baton->image.pixels = nullptr;
+  baton->image.occupancy = nullptr;
   
   status = napi_queue_async_work(env, work);
   if (status != napi_ok) goto out;
@@ -223,6 +267,190 @@ out:
   if (buffer_ref) napi_delete_reference(env, buffer_ref);
   if (work) napi_delete_async_work(env, work);
   if (baton) delete baton;
-  
+
+  if (error) {
+    napi_throw_error(env, NULL, error);
+  }
+  return nullptr;
+}
+
+napi_value slurp(napi_env env, napi_callback_info cbinfo) {
+  return queue_slurp(env, cbinfo, false, false);
+}
+
+napi_value slurp_frames(napi_env env, napi_callback_info cbinfo) {
+  return queue_slurp(env, cbinfo, true, false);
+}
+
+napi_value slurp_file(napi_env env, napi_callback_info cbinfo) {
+  return queue_slurp(env, cbinfo, false, true);
+}
+
+struct slurp_many_baton {
+  napi_async_work work;
+  napi_ref callback;
+  napi_ref gif_buffers_ref; // A private array holding every input buffer
+
+  std::vector<const unsigned char *> gif_buffers;
+  std::vector<size_t> gif_lengths;
+  std::vector<int> errors;
+  std::vector<decoded_image> images;
+};
+
+void slurp_many_execute(napi_env env, void* data)
+{
+  slurp_many_baton *baton = (slurp_many_baton *)data;
+
+  // One job on the shared pool: however long the batch, it takes at most a
+  // thread per core, each keeping its decoder state from image to image
+  parallel_for((int)baton->gif_buffers.size(), [baton](int i) {
+    baton->errors[i] = decode_first_image(baton->gif_buffers[i], baton->gif_lengths[i], nullptr, &baton->images[i]);
+  });
+}
+
+void slurp_many_complete(napi_env env, napi_status status, void* data)
+{
+  slurp_many_baton *baton = (slurp_many_baton *)data;
+  size_t count = baton->images.size();
+
+  napi_value cb;
+  napi_value args[2];
+  napi_value result;
+
+  status = napi_get_reference_value(env, baton->callback, &cb);
+  if (status != napi_ok) goto out;
+
+  status = napi_get_null(env, &args[0]);
+  if (status != napi_ok) goto out;
+
+  status = napi_create_array_with_length(env, count, &args[1]);
+  if (status != napi_ok) goto out;
+
+  for (size_t i = 0; i < count; i++) {
+    napi_value image;
+    status = create_image_object(env, baton->errors[i], &baton->images[i], &image);
+    if (status != napi_ok) goto out;
+    status = napi_set_element(env, args[1], i, image);
+    if (status != napi_ok) goto out;
+  }
+
+  napi_call_function(env, cb, cb, 2, args, &result);
+
+out:
+  for (size_t i = 0; i < count; i++) {
+    free_image(&baton->images[i]);
+  }
+  napi_delete_async_work(env, baton->work);
+  napi_delete_reference(env, baton->callback);
+  napi_delete_reference(env, baton->gif_buffers_ref);
+
+  delete baton;
+}
+
+/*
+ * slurpMany([buffers], cb) decodes the first image of every buffer in one
+ * piece of async work, fanned out over the shared pool, calling
+ * cb(null, results) once where each result is either { width, height,
+ * pixels, unfiltered_palette, filtered_palette, occupancy } or the Error
+ * that buffer gave.
+ */
+napi_value slurp_many(napi_env env, napi_callback_info cbinfo) {
+  napi_status status;
+  napi_async_work work = nullptr;
+  napi_ref callback_ref = nullptr;
+  napi_ref buffers_ref = nullptr;
+  const char *error = nullptr;
+  size_t argc = 2;
+  napi_value argv[2];
+  napi_value cbinfo_this;
+  void *cbinfo_data;
+  napi_value buffers;
+  napi_value description;
+  uint32_t count;
+  bool is_array;
+
+  slurp_many_baton *baton = new slurp_many_baton();
+
+  status = napi_get_cb_info(env, cbinfo, &argc, argv, &cbinfo_this, &cbinfo_data);
+  if (status != napi_ok) goto out;
+  if (argc < 2) {
+    error = "Wrong number of arguments.";
+    goto out;
+  }
+
+  status = napi_is_array(env, argv[0], &is_array);
+  if (status != napi_ok || !is_array) {
+    error = "Expected an array of buffers";
+    goto out;
+  }
+
+  status = napi_get_array_length(env, argv[0], &count);
+  if (status != napi_ok) goto out;
+
+  // The caller's array could change under us, so the buffers are kept
+  // alive through a copy of it instead
+  status = napi_create_array_with_length(env, count, &buffers);
+  if (status != napi_ok) goto out;
+
+  for (uint32_t i = 0; i < count; i++) {
+    napi_value buffer;
+    bool is_buffer;
+    void *gif_bytes;
+    size_t gif_byte_count;
+
+    status = napi_get_element(env, argv[0], i, &buffer);
+    if (status != napi_ok) goto out;
+    status = napi_is_buffer(env, buffer, &is_buffer);
+    if (status != napi_ok || !is_buffer) {
+      error = "Expected an array of buffers";
+      goto out;
+    }
+    status = napi_get_buffer_info(env, buffer, &gif_bytes, &gif_byte_count);
+    if (status != napi_ok) goto out;
+    status = napi_set_element(env, buffers, i, buffer);
+    if (status != napi_ok) goto out;
+
+    baton->gif_buffers.push_back((const unsigned char *)gif_bytes);
+    baton->gif_lengths.push_back(gif_byte_count);
+  }
+  baton->errors.resize(count, 0);
+  baton->images.resize(count);
+  for (uint32_t i = 0; i < count; i++) {
+    baton->images[i].pixels = nullptr;
+    baton->images[i].occupancy = nullptr;
+  }
+
+  status = napi_create_string_utf8(env, "gif slurp many", NAPI_AUTO_LENGTH, &description);
+  if (status != napi_ok) goto out;
+
+  status = napi_create_reference(env, argv[1], 1, &callback_ref);
+  if (status != napi_ok) goto out;
+
+  status = napi_create_reference(env, buffers, 1, &buffers_ref);
+  if (status != napi_ok) goto out;
+
+  status = napi_create_async_work(env, nullptr, description, slurp_many_execute, slurp_many_complete, baton, &work);
+  if (status != napi_ok) goto out;
+
+  baton->work = work;
+  baton->callback = callback_ref;
+  baton->gif_buffers_ref = buffers_ref;
+
+  status = napi_queue_async_work(env, work);
+  if (status != napi_ok) goto out;
+
+  baton = nullptr;
+  work = nullptr;
+  callback_ref = nullptr;
+  buffers_ref = nullptr;
+out:
+  if (callback_ref) napi_delete_reference(env, callback_ref);
+  if (buffers_ref) napi_delete_reference(env, buffers_ref);
+  if (work) napi_delete_async_work(env, work);
+  if (baton) delete baton;
+
+  if (error) {
+    napi_throw_error(env, NULL, error);
+  }
   return nullptr;
 }
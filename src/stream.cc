@@ -0,0 +1,317 @@
+#include <node_api.h>
+#include <uv.h>
+#include <gif_lib.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include "image.h"
+#include "macros.h"
+
+struct stream_chunk {
+  napi_ref buffer_ref;
+  const unsigned char *data;
+  size_t length;
+};
+
+/*
+ * A decoder fed with chunks as they arrive. giflib pulls its input, so the
+ * decode runs on a thread of its own whose read callback blocks until the
+ * next chunk is pushed (or the stream is ended). Decoding then overlaps the
+ * download without holding a threadpool worker for the whole transfer.
+ */
+struct stream_decoder {
+  napi_env env;
+  uv_thread_t thread;
+  uv_mutex_t mutex;
+  uv_cond_t data_available;
+
+  // Guarded by mutex
+  std::deque<stream_chunk> chunks;
+  size_t chunk_offset; // Bytes of chunks.front() already handed to giflib
+  std::vector<napi_ref> consumed; // Fully read chunks, released on the JS thread
+  bool ended;
+  bool abandoned; // The handle was collected without end() being called
+
+  napi_threadsafe_function done;
+  int error; // giflib error code, or 0 if decoding succeeded
+  decoded_image image;
+
+  // Only touched on the JS thread. The decoder is freed once both are set.
+  bool collected;
+  bool finished;
+};
+
+/*
+ * Each decoder holds a thread until its stream ends, so only this many may
+ * be running at once; createDecoder refuses more rather than starting
+ * threads without limit.
+ */
+#define MAX_STREAM_DECODERS 64
+
+// Decoders whose threads have been started and not yet joined, over every env
+static std::atomic<int> running_decoders(0);
+
+int ReadStreamGif (GifFileType *gif_file, GifByteType *buffer, int size) {
+  stream_decoder *decoder = static_cast<stream_decoder *>(gif_file->UserData);
+  int copied = 0;
+
+  uv_mutex_lock(&decoder->mutex);
+  while (copied < size && !decoder->abandoned) {
+    if (decoder->chunks.empty()) {
+      if (decoder->ended) break;
+      uv_cond_wait(&decoder->data_available, &decoder->mutex);
+      continue;
+    }
+
+    stream_chunk &chunk = decoder->chunks.front();
+    size_t copy_length = chunk.length - decoder->chunk_offset;
+    if (copy_length > (size_t)(size - copied)) {
+      // Trim to request
+      copy_length = (size_t)(size - copied);
+    }
+
+    memcpy(buffer + copied, chunk.data + decoder->chunk_offset, copy_length);
+    copied += copy_length;
+    decoder->chunk_offset += copy_length;
+
+    if (decoder->chunk_offset == chunk.length) {
+      decoder->consumed.push_back(chunk.buffer_ref);
+      decoder->chunks.pop_front();
+      decoder->chunk_offset = 0;
+    }
+  }
+  uv_mutex_unlock(&decoder->mutex);
+
+  return copied;
+}
+
+static void decode_stream(void *data) {
+  stream_decoder *decoder = (stream_decoder *)data;
+
+  decoder->error = 0;
+  GifFileType *gif_file = DGifOpen(decoder, ReadStreamGif, &decoder->error);
+  if (gif_file == nullptr) {
+    // DGifOpen does not report a truncated screen descriptor
+    if (!decoder->error) decoder->error = D_GIF_ERR_NO_SCRN_DSCR;
+  } else {
+    decoder->error = read_first_image(gif_file, &decoder->image);
+    DGifCloseFile(gif_file);
+  }
+
+  napi_call_threadsafe_function(decoder->done, nullptr, napi_tsfn_blocking);
+  napi_release_threadsafe_function(decoder->done, napi_tsfn_release);
+}
+
+static void destroy_stream_decoder(napi_env env, stream_decoder *decoder) {
+  if (env) {
+    for (size_t i = 0; i < decoder->chunks.size(); i++) {
+      napi_delete_reference(env, decoder->chunks[i].buffer_ref);
+    }
+    for (size_t i = 0; i < decoder->consumed.size(); i++) {
+      napi_delete_reference(env, decoder->consumed[i]);
+    }
+  }
+
+  free_image(&decoder->image);
+  uv_cond_destroy(&decoder->data_available);
+  uv_mutex_destroy(&decoder->mutex);
+  delete decoder;
+}
+
+static void stream_decoder_complete(napi_env env, napi_value cb, void *context, void *data) {
+  stream_decoder *decoder = (stream_decoder *)context;
+
+  uv_thread_join(&decoder->thread);
+  running_decoders--;
+
+  if (env && !decoder->abandoned) {
+    call_image_callback(env, cb, decoder->error, &decoder->image);
+  }
+  free_image(&decoder->image);
+
+  decoder->finished = true;
+  if (decoder->collected) {
+    destroy_stream_decoder(env, decoder);
+  }
+}
+
+static void stream_decoder_collected(napi_env env, void *data, void *hint) {
+  stream_decoder *decoder = (stream_decoder *)data;
+
+  uv_mutex_lock(&decoder->mutex);
+  if (!decoder->ended) {
+    // Nothing more will ever be pushed, so wake the decode up to fail
+    decoder->abandoned = true;
+    uv_cond_signal(&decoder->data_available);
+  }
+  uv_mutex_unlock(&decoder->mutex);
+
+  decoder->collected = true;
+  if (decoder->finished) {
+    destroy_stream_decoder(env, decoder);
+  }
+}
+
+napi_value create_decoder(napi_env env, napi_callback_info cbinfo) {
+  napi_status status;
+  const char *error = nullptr;
+  size_t argc = 1;
+  napi_value argv[1];
+  napi_value cbinfo_this;
+  void *cbinfo_data;
+  napi_value description;
+  napi_value handle = nullptr;
+
+  stream_decoder *decoder = nullptr;
+
+  status = napi_get_cb_info(env, cbinfo, &argc, argv, &cbinfo_this, &cbinfo_data);
+  if (status != napi_ok) goto out;
+  if (argc < 1) {
+    error = "Wrong number of arguments.";
+    goto out;
+  }
+
+  status = napi_create_string_utf8(env, "gif stream decode", NAPI_AUTO_LENGTH, &description);
+  if (status != napi_ok) goto out;
+
+  decoder = new stream_decoder();
+  decoder->env = env;
+  decoder->chunk_offset = 0;
+  decoder->ended = false;
+  decoder->abandoned = false;
+  decoder->error = 0;
+  decoder->image.pixels = nullptr;
+  decoder->image.occupancy = nullptr;
+  decoder->collected = false;
+  decoder->finished = false;
+
+  status = napi_create_threadsafe_function(env, argv[0], nullptr, description, 0, 1,
+      nullptr, nullptr, decoder, stream_decoder_complete, &decoder->done);
+  if (status != napi_ok) {
+    error = "Callback must be a function";
+    goto out;
+  }
+
+  // An idle decoder should not keep the process alive; end() refs it again
+  napi_unref_threadsafe_function(env, decoder->done);
+
+  uv_mutex_init(&decoder->mutex);
+  uv_cond_init(&decoder->data_available);
+
+  if (++running_decoders > MAX_STREAM_DECODERS) {
+    error = "Too many decoders running at once";
+  } else if (uv_thread_create(&decoder->thread, decode_stream, decoder) != 0) {
+    error = "Could not start decoder thread";
+  }
+  if (error) {
+    running_decoders--;
+    napi_release_threadsafe_function(decoder->done, napi_tsfn_abort);
+    uv_cond_destroy(&decoder->data_available);
+    uv_mutex_destroy(&decoder->mutex);
+    goto out;
+  }
+
+  status = napi_create_external(env, decoder, stream_decoder_collected, nullptr, &handle);
+  if (status != napi_ok) {
+    // The thread owns the decoder now; let it run to completion unheard
+    stream_decoder_collected(env, decoder, nullptr);
+  }
+  decoder = nullptr;
+
+out:
+  if (decoder) delete decoder;
+
+  if (error) {
+    napi_throw_error(env, NULL, error);
+  }
+  return handle;
+}
+
+napi_value decoder_push(napi_env env, napi_callback_info cbinfo) {
+  napi_status status;
+  napi_ref chunk_ref = nullptr;
+  const char *error = nullptr;
+  const char *invalid_arguments_error = "invalid argument types";
+  size_t argc = 2;
+  napi_value argv[2];
+  napi_value cbinfo_this;
+  void *cbinfo_data;
+  std::vector<napi_ref> consumed;
+
+  status = napi_get_cb_info(env, cbinfo, &argc, argv, &cbinfo_this, &cbinfo_data);
+  if (status != napi_ok) goto out;
+  if (argc < 2) {
+    error = "Wrong number of arguments.";
+    goto out;
+  }
+
+  {
+    REQUIRE_ARGUMENT_EXTERNAL(0, stream_decoder, decoder);
+    REQUIRE_ARGUMENT_BUFFER_REF(1, chunk, chunk_length, chunk_ref);
+
+    uv_mutex_lock(&decoder->mutex);
+    if (decoder->ended) {
+      error = "Cannot push after end";
+    } else if (chunk_length > 0) {
+      stream_chunk pushed = { chunk_ref, (const unsigned char *)chunk, chunk_length };
+      decoder->chunks.push_back(pushed);
+      chunk_ref = nullptr;
+      uv_cond_signal(&decoder->data_available);
+    }
+    consumed.swap(decoder->consumed);
+    uv_mutex_unlock(&decoder->mutex);
+  }
+
+out:
+  for (size_t i = 0; i < consumed.size(); i++) {
+    napi_delete_reference(env, consumed[i]);
+  }
+  if (chunk_ref) napi_delete_reference(env, chunk_ref);
+
+  if (error) {
+    napi_throw_error(env, NULL, error);
+  }
+  return nullptr;
+}
+
+napi_value decoder_end(napi_env env, napi_callback_info cbinfo) {
+  napi_status status;
+  const char *error = nullptr;
+  const char *invalid_arguments_error = "invalid argument types";
+  size_t argc = 1;
+  napi_value argv[1];
+  napi_value cbinfo_this;
+  void *cbinfo_data;
+
+  status = napi_get_cb_info(env, cbinfo, &argc, argv, &cbinfo_this, &cbinfo_data);
+  if (status != napi_ok) goto out;
+  if (argc < 1) {
+    error = "Wrong number of arguments.";
+    goto out;
+  }
+
+  {
+    REQUIRE_ARGUMENT_EXTERNAL(0, stream_decoder, decoder);
+
+    uv_mutex_lock(&decoder->mutex);
+    bool already_ended = decoder->ended;
+    decoder->ended = true;
+    uv_cond_signal(&decoder->data_available);
+    uv_mutex_unlock(&decoder->mutex);
+
+    if (already_ended) {
+      error = "Decoder has already been ended";
+    } else if (!decoder->finished) {
+      // Keep the process alive until the result has been delivered
+      napi_ref_threadsafe_function(env, decoder->done);
+    }
+  }
+
+out:
+  if (error) {
+    napi_throw_error(env, NULL, error);
+  }
+  return nullptr;
+}
@@ -1,94 +1,497 @@
 #include <node_api.h>
+#include <math.h>
+#include <stdlib.h>
 #include <memory>
+#include <string.h>
+#include <vector>
+#include "gif.h"
+#include "image.h"
+#include "kernels.h"
 #include "macros.h"
+#include "mercator.h"
+#include "occupancy.h"
+#include "parallel.h"
+#include "png.h"
+#include "rle.h"
+#include "stretch.h"
 
-static const int UNFILTERED_BLANK_OUT_UNTIL = 6;
-static const int FILTERED_BLANK_OUT_UNTIL = 9;
+static inline int clamp(int inclusive_min, int x, int inclusive_max) {
+  return x <= inclusive_min ? inclusive_min
+       : x >= inclusive_max ? inclusive_max
+       : x;
+}
 
-struct stretch_baton {
-  double source_left;
-  double source_right;
-  double source_top;
-  double source_bottom;
 
-  int source_width;
-  int source_height;
-  unsigned char *source_pixels;
-  
-  int result_width;
-  int result_height;
-  int *dest_pixels;
+template <typename Pixel>
+static void fill_rect(Pixel *output, int width, int height, int output_stride, Pixel color) {
+  for (int y = 0; y < height; y++, output += output_stride) {
+    for (int x = 0; x < width; x++) output[x] = color;
+  }
+}
 
-  int *filtered_palette;
-  int *unfiltered_palette;
-  
-  bool filtered;
-
-  napi_async_work work; // So we can delete when we are done
-  napi_ref callback_ref;
-  napi_ref dest_buffer_ref;
-  napi_ref source_buffer_ref;
-  napi_ref unfiltered_palette_buffer_ref;
-  napi_ref filtered_palette_buffer_ref;
+/*
+ * Output pixel formats, each made from a palette entry's R, G, B, A bytes.
+ * Those with alpha keep it where RGBA has it.
+ */
+struct rgba_format {
+  typedef int pixel;
+  static const bool has_alpha = true;
+  static int convert(const uint8_t *rgba) {
+    int color;
+    memcpy(&color, rgba, 4);
+    return color;
+  }
 };
 
-static inline int clamp(int inclusive_min, int x, int inclusive_max) {
-  return x <= inclusive_min ? inclusive_min
-       : x >= inclusive_max ? inclusive_max
-       : x;
+struct bgra_format {
+  typedef int pixel;
+  static const bool has_alpha = true;
+  static int convert(const uint8_t *rgba) {
+    uint8_t bgra[4] = { rgba[2], rgba[1], rgba[0], rgba[3] };
+    return rgba_format::convert(bgra);
+  }
+};
+
+struct premultiplied_format { // RGBA, each color scaled by the alpha
+  typedef int pixel;
+  static const bool has_alpha = true;
+  static int convert(const uint8_t *rgba) {
+    uint8_t scaled[4];
+    for (int i = 0; i < 3; i++) scaled[i] = (uint8_t)((rgba[i] * rgba[3] + 127) / 255);
+    scaled[3] = rgba[3];
+    return rgba_format::convert(scaled);
+  }
+};
+
+struct rgb565_format { // 5 bits of red at the top, then 6 of green, 5 of blue
+  typedef uint16_t pixel;
+  static const bool has_alpha = false;
+  static int convert(const uint8_t *rgba) {
+    return (rgba[0] >> 3) << 11 | (rgba[1] >> 2) << 5 | rgba[2] >> 3;
+  }
+};
+
+/*
+ * What stretch writes for each palette index, and the kernels that write
+ * it. Everything that draws is a template over one of these, so each
+ * output format gets its own loops. A pixel shows if its index's palette
+ * entry is not fully transparent: shows holds that per index, and visible
+ * tells it from a written pixel, which only formats that keep the alpha,
+ * or the index, can. Those without count as they write instead, and row
+ * and quad return how many of their pixels show, the others returning 0.
+ */
+#define NO_VISIBLE_THRESHOLD -2
+
+/*
+ * Palettes usually blank out every index up to some k and show the rest.
+ * This is that k, or NO_VISIBLE_THRESHOLD for palettes that are not like
+ * that. With one, what shows can be told from the index alone.
+ */
+static int visible_threshold(const bool *shows) {
+  int k = 255;
+  while (k >= 0 && shows[k]) k--;
+  for (int i = 0; i < k; i++) {
+    if (shows[i]) return NO_VISIBLE_THRESHOLD;
+  }
+  return k;
+}
+
+template <typename Format>
+struct palette_writer { // The index's palette entry, converted once up front
+  typedef typename Format::pixel pixel;
+  static const bool counts_while_writing = !Format::has_alpha;
+  int table[256]; // Without alpha, 1 << 16 is set in the entries that show
+  int alpha_mask;
+  bool shows[256];
+  int visible_above;
+
+  explicit palette_writer(const int *palette) {
+    const uint8_t *entries = (const uint8_t *)palette;
+    const uint8_t opaque_black[4] = { 0, 0, 0, 0xff };
+    alpha_mask = Format::convert(opaque_black);
+    for (int i = 0; i < 256; i++) {
+      shows[i] = entries[4*i + 3] != 0;
+      table[i] = Format::convert(entries + 4*i) | (counts_while_writing && shows[i] ? 1 << 16 : 0);
+    }
+    visible_above = visible_threshold(shows);
+  }
+
+  pixel color(int index) const { return (pixel)table[index]; }
+  bool visible(pixel p) const {
+    static_assert(!counts_while_writing, "formats without alpha count what shows as they write it");
+    return (p & alpha_mask) != 0;
+  }
+  int count(const pixel *pixels, int n) const { // An int count, so that the loop vectorizes
+    int count = 0;
+    for (int x = 0; x < n; x++) count += visible(pixels[x]);
+    return count;
+  }
+  int row(const unsigned char *row, int readable_past_row, const int *columns, int count, pixel *output) const {
+    if constexpr (counts_while_writing) return zoom_out_row(row, readable_past_row, columns, count, output, table);
+    zoom_out_row(row, readable_past_row, columns, count, output, table);
+    return 0;
+  }
+  long long quad(int ul, int ur, int bl, int br, int width, int height, int first_row, int last_row,
+                 pixel *output, int output_stride) const {
+    if constexpr (counts_while_writing) {
+      return interp_quad(ul, ur, bl, br, width, height, first_row, last_row, output, output_stride, table);
+    }
+    interp_quad(ul, ur, bl, br, width, height, first_row, last_row, output, output_stride, table);
+    return 0;
+  }
+};
+
+struct index_writer { // The index itself, one byte
+  typedef unsigned char pixel;
+  static const bool counts_while_writing = false;
+  bool shows[256];
+  unsigned char written[256];
+  int visible_above;
+
+  // With merge_hidden, fills write every index that does not show as the
+  // first such, for encoders that make them all one transparent index
+  // anyway. Blank stretches then fill alike, whatever the palette.
+  explicit index_writer(const int *palette, bool merge_hidden = false) {
+    const uint8_t *entries = (const uint8_t *)palette;
+    int first_hidden = -1;
+    for (int i = 0; i < 256; i++) {
+      shows[i] = entries[4*i + 3] != 0;
+      if (first_hidden < 0 && !shows[i]) first_hidden = i;
+      written[i] = (unsigned char)(merge_hidden && !shows[i] ? first_hidden : i);
+    }
+    visible_above = visible_threshold(shows);
+  }
+
+  unsigned char color(int index) const { return written[index]; }
+  bool visible(unsigned char p) const { return shows[p]; }
+  int count(const unsigned char *pixels, int n) const {
+    int count = 0;
+    if (visible_above != NO_VISIBLE_THRESHOLD) { // A compare rather than a lookup, so it vectorizes
+      for (int x = 0; x < n; x++) count += pixels[x] > visible_above;
+    } else {
+      for (int x = 0; x < n; x++) count += shows[pixels[x]];
+    }
+    return count;
+  }
+  int row(const unsigned char *row, int readable_past_row, const int *columns, int count,
+          unsigned char *output) const {
+    zoom_out_row(row, readable_past_row, columns, count, output);
+    return 0;
+  }
+  long long quad(int ul, int ur, int bl, int br, int width, int height, int first_row, int last_row,
+                 unsigned char *output, int output_stride) const {
+    interp_quad(ul, ur, bl, br, width, height, first_row, last_row, output, output_stride);
+    return 0;
+  }
+};
+
+/*
+ * How many of a rect of freshly written pixels show, counted while they
+ * are still in cache. Writers that count as they write already know:
+ * written is what they said.
+ */
+template <typename Writer>
+static long long count_visible(const Writer &writer, const typename Writer::pixel *pixels,
+                               int width, int height, int stride, long long written) {
+  if constexpr (Writer::counts_while_writing) {
+    return written;
+  } else {
+    long long count = 0;
+    for (int y = 0; y < height; y++, pixels += stride) count += writer.count(pixels, width);
+    return count;
+  }
+}
+
+/*
+ * Gives row y of the source densely, either straight from the source
+ * pixels or by expanding its runs into scratch.
+ */
+static inline const unsigned char *source_row(stretch_baton *baton, int y, unsigned char *scratch) {
+  if (!baton->source_runs) return baton->source_pixels + (size_t)baton->source_width*y;
+  rle_expand_row(baton->source_runs, baton->source_row_starts, y, scratch);
+  return scratch;
+}
+
+/*
+ * Whether the occupancy map shows source pixels [x1, x2] x [y1, y2] to be
+ * all at or below the blank-out level. Without a map nothing is known to be.
+ */
+static bool source_blank(const stretch_baton *baton, int x1, int x2, int y1, int y2) {
+  if (!baton->occupancy) return false;
+  int occupied = baton->filtered ? OCCUPIED_FILTERED : OCCUPIED_UNFILTERED;
+  int columns = occupancy_columns(baton->source_width);
+  for (int block_y = y1 >> OCCUPANCY_BLOCK_SHIFT; block_y <= y2 >> OCCUPANCY_BLOCK_SHIFT; block_y++) {
+    const unsigned char *blocks = baton->occupancy + (size_t)block_y*columns;
+    for (int block_x = x1 >> OCCUPANCY_BLOCK_SHIFT; block_x <= x2 >> OCCUPANCY_BLOCK_SHIFT; block_x++) {
+      if (blocks[block_x] & occupied) return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * Whether every index up to the blank-out level is written as the same
+ * pixel, so that zoomed out, blank source can be filled in unread
+ */
+template <typename Writer>
+static bool blanks_alike(const Writer &writer, int clamp_min) {
+  for (int i = 1; i <= clamp_min; i++) {
+    if (writer.color(i) != writer.color(0) || writer.shows[i] != writer.shows[0]) return false;
+  }
+  return true;
+}
+
+/*
+ * Nearest-neighbour sampling of one run-length encoded row: each run is
+ * written as one fill covering every output pixel that samples it.
+ * Returns how many of the pixels written show.
+ */
+template <typename Writer>
+static int zoom_out_runs(const rle_run *run, const rle_run *runs_end, int in_x_shifted, int x_step_shifted,
+                          typename Writer::pixel *output, int output_width, const Writer &writer) {
+  int out_x = 0;
+  while (out_x < output_width && (in_x_shifted >> ZOOM_OUT_SHIFT) < 0) {
+    out_x++;
+    in_x_shifted += x_step_shifted;
+  }
+
+  int run_start = 0, shown = 0;
+  for (; run < runs_end && out_x < output_width; run_start += run->length, run++) {
+    long long run_stop_shifted = (long long)(run_start + run->length) << ZOOM_OUT_SHIFT;
+    if (in_x_shifted >= run_stop_shifted) continue;
+
+    long long count = (run_stop_shifted - in_x_shifted + x_step_shifted - 1) / x_step_shifted;
+    if (count > output_width - out_x) count = output_width - out_x;
+
+    typename Writer::pixel color = writer.color(run->value);
+    for (auto *end = output + out_x + count, *at = output + out_x; at < end; at++) *at = color;
+    if (writer.shows[run->value]) shown += (int)count;
+    out_x += (int)count;
+    in_x_shifted += (int)count * x_step_shifted;
+  }
+  return shown;
 }
 
+// A zoomed-in view running right to left or bottom to top, or empty, draws nothing
+static inline bool stretch_flipped(stretch_baton *baton) {
+  return !(baton->source_right > baton->source_left) || !(baton->source_bottom > baton->source_top);
+}
 
-#define SHIFT 20
+static inline bool stretch_zooms_in(stretch_baton *baton) {
+  return (baton->source_right - baton->source_left) * 2 < baton->result_width;
+}
+
+/*
+ * Where each output pixel of a zoomed-out stretch samples the source,
+ * worked out once per call and shared by every band.
+ */
+struct zoom_out_plan {
+  int x_step_shifted;
+  int in_x_shifted_initial;
+
+  // Sampling never turns back, so the output columns that land inside the
+  // source are one span, [first_column, last_column). columns holds the
+  // source column for each of them.
+  int first_column;
+  int last_column;
+  std::vector<int> columns;
+
+  // With a reduction, each of those output columns covers source columns
+  // [columns[i], column_ends[i])
+  std::vector<int> column_ends;
+
+  // The source row at the top of each output row, and of the row past the
+  // last, which may be outside the source
+  std::vector<int> rows;
+};
+
+static void plan_zoom_out(stretch_baton *baton, zoom_out_plan *plan) {
+  double source_height = baton->source_bottom - baton->source_top;
+  double source_width = baton->source_right - baton->source_left;
+
+  plan->x_step_shifted = (int)(source_width/baton->result_width*(1<<ZOOM_OUT_SHIFT) + .5);
+  plan->in_x_shifted_initial = (int)(baton->source_left*(1<<ZOOM_OUT_SHIFT) + 0.5);
+
+  plan->first_column = baton->result_width;
+  plan->last_column = baton->result_width;
+  long long in_x_shifted = plan->in_x_shifted_initial;
+  for (int out_x = 0; out_x < baton->result_width; out_x++, in_x_shifted += plan->x_step_shifted) {
+    long long in_x = in_x_shifted >> ZOOM_OUT_SHIFT;
+    bool inside = in_x >= 0 && in_x < baton->source_width;
+    if (inside && plan->first_column == baton->result_width) plan->first_column = out_x;
+    if (!inside && plan->first_column < out_x) {
+      plan->last_column = out_x;
+      break;
+    }
+    if (inside) plan->columns.push_back((int)in_x);
+  }
+
+  if (baton->reduction != STRETCH_NEAREST && plan->x_step_shifted > 0) {
+    plan->column_ends.resize(plan->columns.size());
+    in_x_shifted = plan->in_x_shifted_initial + (long long)(plan->first_column + 1) * plan->x_step_shifted;
+    for (size_t i = 0; i < plan->columns.size(); i++, in_x_shifted += plan->x_step_shifted) {
+      long long end = in_x_shifted >> ZOOM_OUT_SHIFT;
+      if (end > baton->source_width) end = baton->source_width;
+      plan->column_ends[i] = end > plan->columns[i] ? (int)end : plan->columns[i] + 1;
+    }
+  }
+
+  plan->rows.resize(baton->result_height + 1);
+  if (baton->mercator) {
+    std::shared_ptr<const std::vector<double> > source_rows = mercator_source_rows(baton->north, baton->south,
+        baton->source_height, baton->source_top, baton->source_bottom, baton->result_height);
+    for (int out_y = 0; out_y <= baton->result_height; out_y++) {
+      plan->rows[out_y] = (int)floor((*source_rows)[out_y]);
+    }
+    return;
+  }
+  for (int out_y = 0; out_y <= baton->result_height; out_y++) {
+    plan->rows[out_y] = (int)(out_y*source_height/baton->result_height + baton->source_top);
+  }
+}
 
 /*
- * ul - upper left corner color, left-shifted by SHIFT
- * ur - upper right corner color, left-shifted by SHIFT
- * bl - bottom left corner color, left-shifted by SHIFT
- * br - bottom right corner color, left-shifted by SHIFT
- * width, height - dimensions of quad to draw
- * output - pixels to draw onto. One int per pixel
- * output_stride - how many ints to step to move to the next row
- * palette - 256 color entries, corresponding to interpolated colors
+ * Where the tops of source rows land among the output rows of a
+ * zoomed-in stretch. Projected, each quad is still drawn with straight
+ * sides, which is as close as a pixel at these zooms.
  */
-static void interp_quad(int ul, int ur, int bl, int br, int width, int height, int *output, int output_stride, int *palette) {
-    if (width==0 || height==0) return;
+struct output_rows {
+  bool mercator;
+  double source_top;
+  double height_ratio; // Output rows per source row, unprojected
+  double north;
+  double rows_per_degree;
+  double y_top; // Mercator y of the top of the output
+  double y_ratio; // Output rows per unit of Mercator y
+};
+
+static void plan_output_rows(stretch_baton *baton, output_rows *rows) {
+  rows->mercator = baton->mercator;
+  rows->source_top = baton->source_top;
+  rows->height_ratio = baton->result_height / (baton->source_bottom - baton->source_top);
+  if (baton->mercator) {
+    rows->north = baton->north;
+    rows->rows_per_degree = baton->source_height / (baton->south - baton->north);
+    rows->y_top = mercator_y(baton->north + baton->source_top / rows->rows_per_degree);
+    double y_bottom = mercator_y(baton->north + baton->source_bottom / rows->rows_per_degree);
+    rows->y_ratio = baton->result_height / (y_bottom - rows->y_top);
+  }
+}
+
+static inline int output_row_of(const output_rows &rows, double in_y) {
+  if (!rows.mercator) return (int)((in_y - rows.source_top) * rows.height_ratio);
+  return (int)((mercator_y(rows.north + in_y / rows.rows_per_degree) - rows.y_top) * rows.y_ratio);
+}
 
-    int leftIncr = (bl-ul)/height;
-    int rightIncr = (br-ur)/height;
+static inline double source_row_of(const output_rows &rows, int out_y) {
+  if (!rows.mercator) return out_y / rows.height_ratio + rows.source_top;
+  return (mercator_latitude(rows.y_top + out_y / rows.y_ratio) - rows.north) * rows.rows_per_degree;
+}
 
-    int horizIncr = (ur-ul)/width;
-    int sideDeltaIncr = (rightIncr - leftIncr)/width;
+/*
+ * Reduces the source under output rows [band_top, band_bottom) of a
+ * zoomed-out stretch. The rows an output row covers are first folded into
+ * one per-column maximum or sum, a whole row at a time, and then each
+ * output pixel reduces its stretch of those columns.
+ */
+template <typename Writer>
+static long long reduce_band(stretch_baton *baton, const zoom_out_plan *plan, int band_top, int band_bottom,
+                             const Writer &writer) {
+  typedef typename Writer::pixel pixel;
+  int span = plan->last_column - plan->first_column;
+  if (span <= 0) return 0;
 
-    int left=ul;
-    for (int y = 0; y < height; y++) {
-        int val = left;
-        int *row_ptr = output;
-        for (int x = 0; x < width; x++) {
-            int result = palette[0xff & ((val + (1<<(SHIFT-1))) >> SHIFT)];
-            *row_ptr = result;
+  // Only the source columns under the output are touched
+  int from = plan->columns[0];
+  int width = plan->column_ends[span-1] - from;
+  std::vector<unsigned char> scratch(baton->source_runs ? baton->source_width : 0);
+  std::vector<unsigned char> maxima;
+  std::vector<uint32_t> sums;
+  if (baton->reduction == STRETCH_MAX) maxima.resize(width);
+  else sums.resize(width);
+  int clamp_min = baton->filtered ? FILTERED_BLANK_OUT_UNTIL : UNFILTERED_BLANK_OUT_UNTIL;
+  bool fill_blanks = blanks_alike(writer, clamp_min);
 
-            row_ptr++;
+  long long visible = 0, row_visible = 0;
+  pixel *row_output = (pixel *)baton->dest_pixels + (size_t)band_top*baton->result_width + plan->first_column;
+  for (int out_y = band_top; out_y < band_bottom; out_y++, row_output += baton->result_width) {
+    int in_y = plan->rows[out_y];
+    if (in_y < 0 || in_y >= baton->source_height) continue; // Rows need not run downwards
+    int in_y_end = clamp(in_y+1, plan->rows[out_y+1], baton->source_height);
 
-            val += horizIncr;
+    if (out_y > band_top && in_y == plan->rows[out_y-1] && plan->rows[out_y+1] == plan->rows[out_y]) {
+      memcpy(row_output, row_output - baton->result_width, span * sizeof(pixel));
+      visible += row_visible;
+      continue;
+    }
+
+    int written = 0;
+    if (fill_blanks && source_blank(baton, from, from + width - 1, in_y, in_y_end - 1)) {
+      // Both reductions of blank pixels are blank
+      fill_rect(row_output, span, 1, 0, writer.color(0));
+      if (writer.shows[0]) written = span;
+    } else if (baton->reduction == STRETCH_MAX) {
+      memset(maxima.data(), 0, width);
+      for (int y = in_y; y < in_y_end; y++) {
+        max_rows(source_row(baton, y, scratch.data()) + from, width, maxima.data());
+      }
+      for (int i = 0; i < span; i++) {
+        unsigned char highest = 0;
+        for (int x = plan->columns[i]; x < plan->column_ends[i]; x++) {
+          if (maxima[x - from] > highest) highest = maxima[x - from];
         }
-        output += output_stride;
-        horizIncr += sideDeltaIncr;
-        left += leftIncr;
+        row_output[i] = writer.color(highest);
+        written += writer.shows[highest];
+      }
+    } else {
+      memset(sums.data(), 0, width * sizeof(uint32_t));
+      for (int y = in_y; y < in_y_end; y++) {
+        sum_rows(source_row(baton, y, scratch.data()) + from, width, sums.data());
+      }
+      int rows = in_y_end - in_y;
+      for (int i = 0; i < span; i++) {
+        uint64_t total = 0;
+        for (int x = plan->columns[i]; x < plan->column_ends[i]; x++) total += sums[x - from];
+        uint64_t count = (uint64_t)rows * (plan->column_ends[i] - plan->columns[i]);
+        int mean = (int)((total + count/2) / count);
+        row_output[i] = writer.color(mean);
+        written += writer.shows[mean];
+      }
     }
+    row_visible = count_visible(writer, row_output, span, 1, 0, written);
+    visible += row_visible;
+  }
+  return visible;
 }
 
+// Outputs smaller than this are not worth splitting across threads
+#define PARALLEL_STRETCH_MIN_PIXELS (512*512)
 
-void stretch_execute(napi_env env, void* data)
+// Quads at least this wide are worth counting from their corners
+#define COUNT_QUADS_MIN_WIDTH 8
+
+/*
+ * Renders output rows [band_top, band_bottom), and returns how many of the
+ * pixels it wrote show. Every band works out the same quads and corner
+ * values as a single pass over the whole output would, and only draws the
+ * rows of them that fall inside it, so banding never changes the result.
+ */
+template <typename Writer>
+static long long stretch_band(stretch_baton *baton, const zoom_out_plan *plan, int band_top, int band_bottom,
+                              const Writer &writer)
 {
-  stretch_baton *baton = (stretch_baton *)data;
-    
-  double source_height = baton->source_bottom - baton->source_top;
+  typedef typename Writer::pixel pixel;
+  pixel *dest_pixels = (pixel *)baton->dest_pixels;
+  long long visible = 0;
   double source_width = baton->source_right - baton->source_left;
-  bool zoomed_in = source_width * 2 < baton->result_width;
+  bool zoomed_in = stretch_zooms_in(baton);
   int clamp_min = baton->filtered ? FILTERED_BLANK_OUT_UNTIL : UNFILTERED_BLANK_OUT_UNTIL;
   int clamp_max = 22;
-  int *palette = baton->filtered ? baton->filtered_palette : baton->unfiltered_palette;
+  std::vector<unsigned char> top_scratch, bottom_scratch;
+  if (baton->source_runs) {
+    top_scratch.resize(baton->source_width);
+    bottom_scratch.resize(baton->source_width);
+  }
   
   //memset(baton->dest_pixels, 0, baton->result_width * baton->result_height * 4);
 
@@ -98,32 +501,125 @@ void stretch_execute(napi_env env, void* data)
       int max_in_x = clamp(0, (int)baton->source_right, baton->source_width-1);
       int min_in_y = clamp(0, (int)baton->source_top, baton->source_height-1);
       int max_in_y = clamp(0, (int)baton->source_bottom, baton->source_height-1);
+      int last_x = baton->source_width-1;
+      int last_y = baton->source_height-1;
+      if (stretch_flipped(baton)) return 0;
 
-      double height_ratio = baton->result_height / source_height;
+      output_rows rows;
+      plan_output_rows(baton, &rows);
       double width_ratio = baton->result_width / source_width;
 
+      // Big quads are counted from their corners, a row at a time, and
+      // small ones by looking over each finished row of them, unless the
+      // writer counts them as it draws them
+      bool count_quads = Writer::counts_while_writing ||
+                         (writer.visible_above != NO_VISIBLE_THRESHOLD && width_ratio >= COUNT_QUADS_MIN_WIDTH);
+
+      // A quad whose corners are all blanked out is one flat color, so a
+      // stretch of them is filled in one go rather than interpolated
+      int blank = clamp_min << SHIFT;
+      pixel blank_color = writer.color(clamp_min);
+
       int out_y1, out_y2;
 
-      out_y2 = (int)((min_in_y - baton->source_top) * height_ratio);
+      // Start at the first source row that reaches into the band
+      int first_in_y = clamp(min_in_y, (int)source_row_of(rows, band_top) - 1, max_in_y);
+      while (first_in_y > min_in_y && output_row_of(rows, first_in_y) > band_top) {
+        first_in_y--;
+      }
+
+      out_y2 = output_row_of(rows, first_in_y);
+
+      // Quads read source columns [min_in_x, span_end)
+      int span_end = max_in_x+2 < baton->source_width ? max_in_x+2 : baton->source_width;
+      int expanded_bottom = -1;
 
-      for (int in_y = min_in_y; in_y <= max_in_y; in_y++) {
+      for (int in_y = first_in_y; in_y <= max_in_y; in_y++) {
         out_y1 = out_y2;
-        out_y2 = (int)(((in_y+1) - baton->source_top) * height_ratio);
+        out_y2 = output_row_of(rows, in_y+1);
+        if (out_y1 >= band_bottom) break;
+        if (out_y2 <= out_y1) continue; // Nothing to draw, and clipping would divide by zero
+        if (out_y2 <= band_top) continue;
+
+        // The last row and column are stretched out to the edge
+        int bottom_y = in_y < last_y ? in_y+1 : last_y;
+        int row_x1 = clamp(0, (int)((min_in_x - baton->source_left) * width_ratio), baton->result_width);
+
+        // A row of quads over nothing but blank blocks is one fill, and the
+        // source is never read
+        if (source_blank(baton, min_in_x, max_in_x < last_x ? max_in_x+1 : last_x, in_y, bottom_y)) {
+          int fill_x2 = clamp(0, (int)(((max_in_x+1) - baton->source_left) * width_ratio), baton->result_width);
+          int fill_y1 = clamp(band_top, out_y1, band_bottom);
+          int fill_y2 = clamp(band_top, out_y2, band_bottom);
+          if (fill_x2 > row_x1 && fill_y2 > fill_y1) {
+            fill_rect(dest_pixels + row_x1 + (size_t)baton->result_width*fill_y1,
+                      fill_x2-row_x1, fill_y2-fill_y1, baton->result_width, blank_color);
+            if (writer.shows[clamp_min]) visible += (long long)(fill_x2-row_x1) * (fill_y2-fill_y1);
+          }
+          continue;
+        }
+
+        const unsigned char *top_row, *bottom_row;
+        if (!baton->source_runs) {
+          top_row = source_row(baton, in_y, nullptr);
+          bottom_row = source_row(baton, bottom_y, nullptr);
+        } else {
+          // Only the columns under the view are expanded, and each row only
+          // once, as the bottom of one row of quads and then the top of the next
+          if (in_y == expanded_bottom) {
+            top_scratch.swap(bottom_scratch);
+          } else {
+            rle_expand_span(baton->source_runs, baton->source_row_starts, in_y, min_in_x, span_end, top_scratch.data());
+          }
+          rle_expand_span(baton->source_runs, baton->source_row_starts, bottom_y, min_in_x, span_end, bottom_scratch.data());
+          expanded_bottom = bottom_y;
+          top_row = top_scratch.data();
+          bottom_row = bottom_scratch.data();
+        }
 
         int ul, ur, bl, br;
         int out_x1, out_x2;
 
-        ur = clamp(clamp_min, baton->source_pixels[min_in_x + in_y*baton->source_width], clamp_max) << SHIFT;
-        br = clamp(clamp_min, baton->source_pixels[min_in_x + (in_y+1)*baton->source_width], clamp_max) << SHIFT;
+        ur = clamp(clamp_min, top_row[min_in_x], clamp_max) << SHIFT;
+        br = clamp(clamp_min, bottom_row[min_in_x], clamp_max) << SHIFT;
         out_x2 = (int)((min_in_x - baton->source_left) * width_ratio);
 
         for (int in_x = min_in_x; in_x <= max_in_x; in_x++) {
+          int next_x = in_x < last_x ? in_x+1 : last_x;
           ul = ur; // This quad's left is the old quad's right
           bl = br;
-          ur = clamp(clamp_min, baton->source_pixels[(in_x+1) + in_y*baton->source_width], clamp_max) << SHIFT;
-          br = clamp(clamp_min, baton->source_pixels[(in_x+1) + (in_y+1)*baton->source_width], clamp_max) << SHIFT;
+          ur = clamp(clamp_min, top_row[next_x], clamp_max) << SHIFT;
+          br = clamp(clamp_min, bottom_row[next_x], clamp_max) << SHIFT;
 
           out_x1 = out_x2;
+
+          if (ul == blank && ur == blank && bl == blank && br == blank) {
+            while (in_x < max_in_x) {
+              int after_x = in_x+1 < last_x ? in_x+2 : last_x;
+              if (source_blank(baton, after_x, after_x, in_y, bottom_y)) {
+                // So is the rest of after_x's block
+                in_x = clamp(in_x+1, (after_x | (OCCUPANCY_BLOCK-1)) - 1, max_in_x);
+                continue;
+              }
+              if (top_row[after_x] > clamp_min || bottom_row[after_x] > clamp_min) break;
+              in_x++;
+            }
+            out_x2 = (int)(((in_x+1) - baton->source_left) * width_ratio);
+
+            int fill_x1 = clamp(0, out_x1, baton->result_width);
+            int fill_x2 = clamp(0, out_x2, baton->result_width);
+            int fill_y1 = clamp(band_top, out_y1, band_bottom);
+            int fill_y2 = clamp(band_top, out_y2, band_bottom);
+            if (fill_x2 > fill_x1 && fill_y2 > fill_y1) {
+              fill_rect(dest_pixels + fill_x1 + baton->result_width*fill_y1,
+                        fill_x2-fill_x1, fill_y2-fill_y1, baton->result_width, blank_color);
+              if (count_quads && writer.shows[clamp_min]) {
+                visible += (long long)(fill_x2-fill_x1) * (fill_y2-fill_y1);
+              }
+            }
+            continue;
+          }
+
           out_x2 = (int)(((in_x+1) - baton->source_left) * width_ratio);
 
           int this_out_y1 = out_y1, this_out_y2 = out_y2;
@@ -147,43 +643,275 @@ void stretch_execute(napi_env env, void* data)
             br = (bl-br)*(out_x2-baton->result_width)/(out_x2-out_x1) + br;
             out_x2=baton->result_width;
           }
-          interp_quad(ul, ur, bl, br, out_x2-out_x1, this_out_y2-this_out_y1,
-              baton->dest_pixels + out_x1 + (baton->result_width*this_out_y1),
-              baton->result_width,
-              palette);
+          int first_row = clamp(0, band_top-this_out_y1, this_out_y2-this_out_y1);
+          int last_row = clamp(0, band_bottom-this_out_y1, this_out_y2-this_out_y1);
+          long long written = writer.quad(ul, ur, bl, br, out_x2-out_x1, this_out_y2-this_out_y1, first_row, last_row,
+              dest_pixels + out_x1 + (baton->result_width*this_out_y1),
+              baton->result_width);
+          if (Writer::counts_while_writing) {
+            visible += written;
+          } else if (count_quads) {
+            visible += interp_quad_count_above(ul, ur, bl, br, out_x2-out_x1, this_out_y2-this_out_y1,
+                                               first_row, last_row, writer.visible_above);
+          }
+        }
+        if (count_quads) continue;
+
+        // The quads and fills tile this stretch of rows, so it is counted in
+        // one go, long rows vectorizing better than each quad's few pixels
+        int row_x2 = clamp(0, out_x2, baton->result_width);
+        int row_y1 = clamp(band_top, out_y1, band_bottom);
+        int row_y2 = clamp(band_top, out_y2, band_bottom);
+        if (row_x2 > row_x1) {
+          visible += count_visible(writer, dest_pixels + row_x1 + (size_t)baton->result_width*row_y1,
+                                   row_x2-row_x1, row_y2-row_y1, baton->result_width, 0);
         }
       }
+  } else if (!plan->column_ends.empty()) {
+      visible = reduce_band(baton, plan, band_top, band_bottom, writer);
   } else {
-      int i=0;
-#define ZOOM_OUT_SHIFT 15
-      //int min_out_x = clamp(0, (0-baton->source_left)*width_ratio, baton->result_width);
-      //int max_out_x = clamp(0, (baton->source_width-baton->source_left)*width_ratio, baton->result_width);
-
-      int x_step_shifted = (int)(source_width/baton->result_width*(1<<ZOOM_OUT_SHIFT) + .5);
-      int in_x_shifted_initial = (int)(baton->source_left*(1<<ZOOM_OUT_SHIFT) + 0.5);
-      for (int out_y = 0; out_y < baton->result_height; out_y++) {
-        int in_y = (int)(out_y*source_height/baton->result_height + baton->source_top);
-        if (in_y < 0) {
-          i += baton->result_width;
+      int span = plan->last_column - plan->first_column;
+      long long row_visible = 0;
+      // Run-length rows already fill blank runs whole; the map only helps dense ones
+      bool fill_blanks = span > 0 && !baton->source_runs && blanks_alike(writer, clamp_min);
+      pixel *row_output = dest_pixels + (size_t)band_top*baton->result_width + plan->first_column;
+      for (int out_y = band_top; out_y < band_bottom; out_y++, row_output += baton->result_width) {
+        int in_y = plan->rows[out_y];
+        if (in_y < 0 || in_y >= baton->source_height) continue; // Rows need not run downwards
+
+        // Zoomed out vertically less than horizontally, neighbouring rows
+        // often sample the same source row and come out identical
+        if (out_y > band_top && in_y == plan->rows[out_y-1]) {
+          memcpy(row_output, row_output - baton->result_width, span * sizeof(pixel));
+          visible += row_visible;
           continue;
         }
-        if (in_y >= baton->source_height) break;
 
-        unsigned char *scan_line = baton->source_pixels + baton->source_width*in_y;
+        int written;
+        if (fill_blanks && source_blank(baton, plan->columns[0], plan->columns[span-1], in_y, in_y)) {
+          fill_rect(row_output, span, 1, 0, writer.color(0));
+          written = writer.shows[0] ? span : 0;
+        } else if (baton->source_runs && plan->x_step_shifted > 0) {
+          written = zoom_out_runs(baton->source_runs + baton->source_row_starts[in_y],
+                        baton->source_runs + baton->source_row_starts[in_y+1],
+                        plan->in_x_shifted_initial, plan->x_step_shifted,
+                        row_output - plan->first_column, baton->result_width, writer);
+        } else {
+          const unsigned char *scan_line = source_row(baton, in_y, top_scratch.data());
+          int readable_past_row = !baton->source_runs && in_y+1 < baton->source_height ? baton->source_width : 0;
 
-        // todo: find bounds first, then loop
-        int in_x_shifted = in_x_shifted_initial;
-        for (int out_x=0; out_x < baton->result_width; out_x++, in_x_shifted += x_step_shifted) {
-          int in_x = in_x_shifted >> ZOOM_OUT_SHIFT;
+          written = writer.row(scan_line, readable_past_row, plan->columns.data(), span, row_output);
+        }
+        row_visible = count_visible(writer, row_output, span, 1, 0, written);
+        visible += row_visible;
+      }
+  }
+  return visible;
+}
 
-          if (in_x >=0 && in_x < baton->source_width) {
-            baton->dest_pixels[i] = palette[scan_line[in_x]];
-          }
+template <typename Writer>
+static void render_bands(stretch_baton *baton, const zoom_out_plan &plan, const Writer &writer)
+{
+  int height = baton->result_height;
 
-          i++;
-        }
+  if (baton->single_band || (long long)baton->result_width * height < PARALLEL_STRETCH_MIN_PIXELS) {
+    baton->visible_pixels = stretch_band(baton, &plan, 0, height, writer);
+    return;
+  }
+
+  // Several bands per thread so that uneven ones even out
+  int bands = parallel_thread_count(height) * 4;
+  if (bands > height) bands = height;
+  std::vector<long long> visible(bands);
+  parallel_for(bands, [baton, &plan, &writer, &visible, height, bands](int band) {
+    visible[band] = stretch_band(baton, &plan, (int)((long long)height * band / bands),
+                                 (int)((long long)height * (band+1) / bands), writer);
+  });
+  baton->visible_pixels = 0;
+  for (int band = 0; band < bands; band++) baton->visible_pixels += visible[band];
+}
+
+/*
+ * The part of the output a stretch writes, [left, right) x [top, bottom):
+ * every pixel inside it and none outside, which is left as it was.
+ */
+struct output_rect {
+  int left;
+  int top;
+  int right;
+  int bottom;
+};
+
+static output_rect written_rect(stretch_baton *baton, const zoom_out_plan &plan) {
+  output_rect rect = { 0, 0, 0, 0 };
+  if (stretch_zooms_in(baton)) {
+    int min_in_x = clamp(0, (int)baton->source_left, baton->source_width-1);
+    int max_in_x = clamp(0, (int)baton->source_right, baton->source_width-1);
+    int min_in_y = clamp(0, (int)baton->source_top, baton->source_height-1);
+    int max_in_y = clamp(0, (int)baton->source_bottom, baton->source_height-1);
+    if (stretch_flipped(baton)) return rect;
+    double width_ratio = baton->result_width / (baton->source_right - baton->source_left);
+    output_rows rows;
+    plan_output_rows(baton, &rows);
+
+    rect.left = clamp(0, (int)((min_in_x - baton->source_left) * width_ratio), baton->result_width);
+    rect.right = clamp(0, (int)(((max_in_x+1) - baton->source_left) * width_ratio), baton->result_width);
+    rect.top = clamp(0, output_row_of(rows, min_in_y), baton->result_height);
+    rect.bottom = clamp(0, output_row_of(rows, max_in_y+1), baton->result_height);
+  } else {
+    rect.left = plan.first_column;
+    rect.right = plan.last_column;
+    rect.top = baton->result_height;
+    for (int out_y = 0; out_y < baton->result_height; out_y++) {
+      if (plan.rows[out_y] < 0 || plan.rows[out_y] >= baton->source_height) continue;
+      if (rect.top > out_y) rect.top = out_y;
+      rect.bottom = out_y + 1;
+    }
+  }
+  if (rect.right <= rect.left || rect.bottom <= rect.top) rect.right = rect.left = rect.bottom = rect.top = 0;
+  return rect;
+}
+
+void render_stretch(stretch_baton *baton)
+{
+  zoom_out_plan plan;
+  if (!stretch_zooms_in(baton)) plan_zoom_out(baton, &plan);
+
+  const int *palette = baton->filtered ? baton->filtered_palette : baton->unfiltered_palette;
+  switch (baton->format) {
+    case STRETCH_RGBA: render_bands(baton, plan, palette_writer<rgba_format>(palette)); break;
+    case STRETCH_BGRA: render_bands(baton, plan, palette_writer<bgra_format>(palette)); break;
+    case STRETCH_PREMULTIPLIED: render_bands(baton, plan, palette_writer<premultiplied_format>(palette)); break;
+    case STRETCH_RGB565: render_bands(baton, plan, palette_writer<rgb565_format>(palette)); break;
+    case STRETCH_INDEXED: render_bands(baton, plan, index_writer(palette)); break;
+  }
+}
+
+/*
+ * Renders a stretch as palette indices and encodes them as the baton asks.
+ */
+static void render_encoded(stretch_baton *baton)
+{
+  size_t pixel_count = (size_t)baton->result_width * baton->result_height;
+  const int *entries = baton->filtered ? baton->filtered_palette : baton->unfiltered_palette;
+  const uint8_t *colors = (const uint8_t *)entries;
+  unsigned char *indices = (unsigned char *)malloc(pixel_count + 1);
+  if (!indices) {
+    baton->encode_error = "Out of memory";
+    return;
+  }
+
+  zoom_out_plan plan;
+  if (!stretch_zooms_in(baton)) plan_zoom_out(baton, &plan);
+  stretch_baton indexed = *baton;
+  indexed.format = STRETCH_INDEXED;
+  indexed.dest_pixels = indices;
+  render_bands(&indexed, plan, index_writer(entries, true));
+  baton->visible_pixels = indexed.visible_pixels;
+
+  // Everything outside the rect the stretch wrote is outside the source
+  output_rect rect = written_rect(baton, plan);
+  bool untouched = (size_t)(rect.right - rect.left) * (rect.bottom - rect.top) < pixel_count;
+  bool used[256] = { false };
+  for (int y = rect.top; y < rect.bottom; y++) {
+    const unsigned char *row = indices + (size_t)baton->result_width*y;
+    for (int x = rect.left; x < rect.right; x++) used[row[x]] = true;
+  }
+
+  // Every index whose color is transparent becomes the one transparent
+  // index, which a GIF can only have one of anyway
+  uint8_t palette[256*4];
+  memcpy(palette, colors, sizeof(palette));
+  bool gif = baton->encoding == STRETCH_GIF;
+  bool needs_transparent = untouched;
+  for (int i = 0; i < 256; i++) {
+    if (used[i] && palette[4*i + 3] == 0) needs_transparent = true;
+  }
+
+  // Untouched pixels need an index that is transparent: one the palette
+  // already has, or else one no pixel uses, which is made transparent
+  int transparent = -1;
+  if (needs_transparent) {
+    int unused = -1;
+    for (transparent = 0; transparent < 256 && palette[4*transparent + 3] != 0; transparent++) {
+      if (unused < 0 && !used[transparent]) unused = transparent;
+    }
+    if (transparent == 256) {
+      if (unused < 0) {
+        // Making any index transparent would recolor the pixels using it
+        baton->encode_error = "No palette index is left for transparent pixels";
+        free(indices);
+        return;
       }
+      transparent = unused;
+      memset(palette + 4*transparent, 0, 4);
+    }
   }
+
+  unsigned char mapped[256];
+  bool remaps = false;
+  for (int i = 0; i < 256; i++) {
+    mapped[i] = transparent >= 0 && palette[4*i + 3] == 0 ? (unsigned char)transparent : (unsigned char)i;
+    if (used[i] && mapped[i] != i) remaps = true;
+  }
+  if (remaps) {
+    for (int y = rect.top; y < rect.bottom; y++) {
+      unsigned char *row = indices + (size_t)baton->result_width*y;
+      for (int x = rect.left; x < rect.right; x++) row[x] = mapped[row[x]];
+    }
+  }
+  if (untouched) {
+    for (int y = 0; y < baton->result_height; y++) {
+      unsigned char *row = indices + (size_t)baton->result_width*y;
+      if (y < rect.top || y >= rect.bottom) {
+        memset(row, transparent, baton->result_width);
+      } else {
+        memset(row, transparent, rect.left);
+        memset(row + rect.right, transparent, baton->result_width - rect.right);
+      }
+    }
+  }
+
+  bool encoded_used[256] = { false };
+  for (int i = 0; i < 256; i++) {
+    if (used[i]) encoded_used[mapped[i]] = true;
+  }
+  if (untouched) encoded_used[transparent] = true;
+
+  int palette_size = 1;
+  for (int i = 0; i < 256; i++) {
+    if (encoded_used[i]) palette_size = i + 1;
+  }
+
+  if (gif) {
+    baton->encoded = encode_indexed_gif(indices, baton->result_width, baton->result_height,
+                                        palette, palette_size, transparent, &baton->encoded_length);
+  } else {
+    baton->encoded = encode_indexed_png(indices, baton->result_width, baton->result_height,
+                                        palette, palette_size, &baton->encoded_length);
+  }
+  if (!baton->encoded) baton->encode_error = "Out of memory";
+  free(indices);
+}
+
+void stretch_execute(napi_env env, void* data)
+{
+  stretch_baton *baton = (stretch_baton *)data;
+  if (baton->encoding != STRETCH_RAW) render_encoded(baton);
+  else render_stretch(baton);
+}
+
+napi_status create_stretch_stats(napi_env env, long long visible_pixels, napi_value *stats) {
+  napi_value covered, empty;
+  napi_status status = napi_create_object(env, stats);
+  if (status != napi_ok) return status;
+  status = napi_create_int64(env, visible_pixels, &covered);
+  if (status != napi_ok) return status;
+  status = napi_get_boolean(env, visible_pixels == 0, &empty);
+  if (status != napi_ok) return status;
+  status = napi_set_named_property(env, *stats, "covered", covered);
+  if (status != napi_ok) return status;
+  return napi_set_named_property(env, *stats, "empty", empty);
 }
 
 void stretch_complete(napi_env env, napi_status status, void* data)
@@ -199,18 +927,43 @@ void stretch_complete(napi_env env, napi_status status, void* data)
   status = napi_get_null(env, &err);
   if (status != napi_ok) goto out;
 
-  napi_value args[1];
+  napi_value args[3];
   args[0] = err;
 
+  napi_value stats;
   napi_value result;
-  napi_call_function(env, cb, cb, 1, args, &result);
+  if (baton->encoding != STRETCH_RAW) {
+    if (!baton->encoded) {
+      napi_value message;
+      status = napi_create_string_utf8(env, baton->encode_error, NAPI_AUTO_LENGTH, &message);
+      if (status != napi_ok) goto out;
+      status = napi_create_error(env, nullptr, message, &args[0]);
+      if (status != napi_ok) goto out;
+      napi_call_function(env, cb, cb, 1, args, &result);
+      goto out;
+    }
+    status = create_stretch_stats(env, baton->visible_pixels, &stats);
+    if (status != napi_ok) goto out;
+    status = create_owned_buffer(env, (void **)&baton->encoded, baton->encoded_length, &args[1]);
+    if (status != napi_ok) goto out;
+    args[2] = stats;
+    napi_call_function(env, cb, cb, 3, args, &result);
+  } else {
+    status = create_stretch_stats(env, baton->visible_pixels, &stats);
+    if (status != napi_ok) goto out;
+    args[1] = stats;
+    napi_call_function(env, cb, cb, 2, args, &result);
+  }
   
   
 out:
+  free(baton->encoded);
   napi_delete_async_work(env, baton->work);
   napi_delete_reference(env, baton->callback_ref);
-  napi_delete_reference(env, baton->dest_buffer_ref);
+  if (baton->dest_buffer_ref) napi_delete_reference(env, baton->dest_buffer_ref);
   napi_delete_reference(env, baton->source_buffer_ref);
+  if (baton->row_starts_buffer_ref) napi_delete_reference(env, baton->row_starts_buffer_ref);
+  if (baton->occupancy_buffer_ref) napi_delete_reference(env, baton->occupancy_buffer_ref);
   napi_delete_reference(env, baton->unfiltered_palette_buffer_ref);
   napi_delete_reference(env, baton->filtered_palette_buffer_ref);
   
@@ -218,11 +971,156 @@ out:
 }
 
 
-napi_value stretch(napi_env env, napi_callback_info cbinfo) {
+const char *read_stretch_latitudes(napi_env env, napi_value latitudes, stretch_baton *baton) {
+  napi_status status;
+  const char *error = nullptr;
+  const char *invalid_arguments_error = "Latitudes must be { north, south }";
+  napi_valuetype type;
+  double north = NAN, south = NAN;
+
+  baton->mercator = false;
+  status = napi_typeof(env, latitudes, &type);
+  if (status != napi_ok) return invalid_arguments_error;
+  if (type == napi_undefined || type == napi_null) return nullptr;
+  if (type != napi_object) return invalid_arguments_error;
+
+  OPTIONAL_PROPERTY_DOUBLE(latitudes, "north", north);
+  OPTIONAL_PROPERTY_DOUBLE(latitudes, "south", south);
+  if (!isfinite(north) || !isfinite(south) || north == south) return invalid_arguments_error;
+
+  baton->mercator = true;
+  baton->north = north;
+  baton->south = south;
+
+out:
+  if (status != napi_ok && !error) error = invalid_arguments_error;
+  return error;
+}
+
+const char *read_stretch_reduction(napi_env env, napi_value reduction, stretch_baton *baton) {
+  napi_valuetype type;
+  char name[8];
+  size_t length;
+
+  baton->reduction = STRETCH_NEAREST;
+  if (napi_typeof(env, reduction, &type) != napi_ok) return "invalid argument types";
+  if (type == napi_undefined || type == napi_null) return nullptr;
+  if (type != napi_string
+      || napi_get_value_string_utf8(env, reduction, name, sizeof(name), &length) != napi_ok) {
+    return "Reduction must be \"nearest\", \"max\" or \"mean\"";
+  }
+
+  if (!strcmp(name, "nearest")) baton->reduction = STRETCH_NEAREST;
+  else if (!strcmp(name, "max")) baton->reduction = STRETCH_MAX;
+  else if (!strcmp(name, "mean")) baton->reduction = STRETCH_MEAN;
+  else return "Reduction must be \"nearest\", \"max\" or \"mean\"";
+  return nullptr;
+}
+
+const char *read_stretch_format(napi_env env, napi_value format, stretch_baton *baton) {
+  static const struct {
+    const char *name;
+    stretch_format format;
+  } formats[] = {
+    { "rgba", STRETCH_RGBA },
+    { "bgra", STRETCH_BGRA },
+    { "premultiplied", STRETCH_PREMULTIPLIED },
+    { "rgb565", STRETCH_RGB565 },
+    { "indexed", STRETCH_INDEXED }
+  };
+  const char *invalid_format_error = "Format must be \"rgba\", \"bgra\", \"premultiplied\", \"rgb565\" or \"indexed\"";
+  napi_valuetype type;
+  char name[16];
+  size_t length;
+
+  baton->format = STRETCH_RGBA;
+  if (napi_typeof(env, format, &type) != napi_ok) return "invalid argument types";
+  if (type == napi_undefined || type == napi_null) return nullptr;
+  if (type != napi_string
+      || napi_get_value_string_utf8(env, format, name, sizeof(name), &length) != napi_ok) {
+    return invalid_format_error;
+  }
+
+  for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+    if (!strcmp(name, formats[i].name)) {
+      baton->format = formats[i].format;
+      return nullptr;
+    }
+  }
+  return invalid_format_error;
+}
+
+const char *read_stretch_occupancy(napi_env env, napi_value occupancy, int width, int height,
+                                   stretch_baton *baton, napi_ref *ref) {
+  napi_valuetype type;
+  bool is_buffer;
+  void *data;
+  size_t length;
+
+  baton->occupancy = nullptr;
+  if (napi_typeof(env, occupancy, &type) != napi_ok) return "invalid argument types";
+  if (type == napi_undefined || type == napi_null) return nullptr;
+  if (napi_is_buffer(env, occupancy, &is_buffer) != napi_ok || !is_buffer
+      || napi_get_buffer_info(env, occupancy, &data, &length) != napi_ok) {
+    return "invalid argument types";
+  }
+  if (length != occupancy_size(width, height)) return "Occupancy map does not match the source";
+  if (napi_create_reference(env, occupancy, 1, ref) != napi_ok) return "invalid argument types";
+
+  baton->occupancy = (const unsigned char *)data;
+  return nullptr;
+}
+
+int stretch_pixel_bytes(stretch_format format) {
+  switch (format) {
+    case STRETCH_INDEXED: return 1;
+    case STRETCH_RGB565: return 2;
+    default: return 4;
+  }
+}
+
+const char *stretch_source_error(const void *source, size_t source_length,
+                                 const void *row_starts, size_t row_starts_length,
+                                 int width, int height, bool run_length) {
+  if (run_length) {
+    if (width <= 0 || height <= 0
+        || row_starts_length != (size_t)(height + 1) * sizeof(uint32_t)
+        || source_length % sizeof(rle_run) != 0
+        || !rle_is_consistent((const rle_run *)source, source_length / sizeof(rle_run),
+                              (const uint32_t *)row_starts, width, height)) {
+      return "Runs are not consistent with given width and height";
+    }
+  } else if (width <= 0 || height <= 0 || width*height != (int32_t)source_length) {
+    return "Buffer length is not consistent with given width and height";
+  }
+  return nullptr;
+}
+
+/*
+ * stretch(pixels, ..., dest, cb[, latitudes[, reduction[, format[,
+ * occupancy]]]]) for a dense source, or stretchRle(runs, ..., dest, cb,
+ * row_starts[, latitudes[, reduction[, format[, occupancy]]]]) for a
+ * run-length encoded one. Given latitudes, { north, south }, the output is
+ * Web Mercator; see stretch_baton. dest holds pixels as format lays them
+ * out; see stretch_format. occupancy is the source's map from decoding,
+ * which lets blank blocks be filled without being read. When done,
+ * cb(null, { covered, empty }): how many pixels show, and whether none do.
+ *
+ * Encoded, stretchToPng or stretchToGif(source, ..., filtered, cb[,
+ * row_starts[, latitudes[, reduction[, occupancy]]]]) instead calls cb(null, file) with
+ * an indexed PNG or a GIF of the result, in which pixels outside the
+ * source are transparent. The source is run-length encoded if row_starts
+ * is given, and { covered, empty } follows the file. A GIF cannot be
+ * partly transparent, so translucent colors come out opaque.
+ */
+static napi_value queue_stretch(napi_env env, napi_callback_info cbinfo, bool run_length, stretch_encoding encoding) {
+  bool encoded = encoding != STRETCH_RAW;
   napi_status status;
   napi_async_work work = nullptr;
   napi_ref callback_ref = nullptr;
   napi_ref source_buffer_ref = nullptr;
+  napi_ref row_starts_buffer_ref = nullptr;
+  napi_ref occupancy_buffer_ref = nullptr;
   napi_ref dest_buffer_ref = nullptr;
   napi_ref unfiltered_palette_buffer_ref = nullptr;
   napi_ref filtered_palette_buffer_ref = nullptr;
@@ -231,14 +1129,19 @@ napi_value stretch(napi_env env, napi_callback_info cbinfo) {
   const char *invalid_arguments_error = "invalid argument types";
   napi_value cbinfo_this;
   void *cbinfo_data;
-  size_t argc = 14;
-  napi_value argv[14];
+  size_t argc = 19;
+  napi_value argv[19];
+  void *row_starts = nullptr;
+  size_t row_starts_length = 0;
+  void *dest_buffer = nullptr;
+  size_t dest_buffer_length = 0;
+  size_t next_arg = 12; // Past the arguments every form shares
 
   stretch_baton *baton = nullptr;
 
   status = napi_get_cb_info(env, cbinfo, &argc, argv, &cbinfo_this, &cbinfo_data);
   if (status != napi_ok) goto out;
-  if (argc < 10) {
+  if (argc < (encoded ? 13u : run_length ? 15u : 10u)) {
     error = "Wrong number of arguments.";
     goto out;
   }
@@ -261,23 +1164,64 @@ napi_value stretch(napi_env env, napi_callback_info cbinfo) {
   REQUIRE_ARGUMENT_INTEGER(9, result_width);
   REQUIRE_ARGUMENT_INTEGER(10, result_height);
   REQUIRE_ARGUMENT_BOOLEAN(11, filtered);
-  REQUIRE_ARGUMENT_BUFFER_REF(12, dest_buffer, dest_buffer_length, dest_buffer_ref);
+  if (!encoded) {
+    REQUIRE_ARGUMENT_BUFFER_REF(12, dest, dest_length, dest_buffer_ref);
+    dest_buffer = dest;
+    dest_buffer_length = dest_length;
+    next_arg++;
+  }
   
-  status = napi_create_reference(env, argv[13], 1, &callback_ref); \
+  status = napi_create_reference(env, argv[next_arg++], 1, &callback_ref);
   if (status != napi_ok) goto out;
+
+  if (encoded && argc > next_arg) {
+    napi_valuetype row_starts_type;
+    status = napi_typeof(env, argv[next_arg], &row_starts_type);
+    if (status != napi_ok) goto out;
+    run_length = row_starts_type != napi_undefined && row_starts_type != napi_null;
+    if (!run_length) next_arg++;
+  }
+  if (run_length) {
+    REQUIRE_ARGUMENT_BUFFER_REF(next_arg, row_starts_buffer, row_starts_buffer_length, row_starts_buffer_ref);
+    row_starts = row_starts_buffer;
+    row_starts_length = row_starts_buffer_length;
+    next_arg++;
+  }
   
+  if (argc > next_arg) {
+    error = read_stretch_latitudes(env, argv[next_arg], baton);
+    if (error) goto out;
+  }
+  next_arg++;
+  if (argc > next_arg) {
+    error = read_stretch_reduction(env, argv[next_arg], baton);
+    if (error) goto out;
+  }
+  next_arg++;
+  if (!encoded) {
+    if (argc > next_arg) {
+      error = read_stretch_format(env, argv[next_arg], baton);
+      if (error) goto out;
+    }
+    next_arg++;
+  }
+  if (argc > next_arg) {
+    error = read_stretch_occupancy(env, argv[next_arg], source_width, source_height, baton, &occupancy_buffer_ref);
+    if (error) goto out;
+  }
+
   if (filtered_palette_length != 256*4 || unfiltered_palette_length != 256*4) {
       error = "Palette buffers must be of length 256";
       goto out;
   }
-  if (result_width <= 0 || result_height <= 0 || result_width*result_height*4 != (int32_t)dest_buffer_length) {
-      error = "Buffer length is not consistent with given width and height";
-      goto out;
-  }
-  if (source_width <= 0 || source_height <= 0 || source_width*source_height != (int32_t)source_buffer_length) {
+  if (result_width <= 0 || result_height <= 0
+      || (!encoded && result_width*result_height*stretch_pixel_bytes(baton->format) != (int32_t)dest_buffer_length)) {
       error = "Buffer length is not consistent with given width and height";
       goto out;
   }
+  error = stretch_source_error(source_buffer, source_buffer_length, row_starts, row_starts_length,
+                               source_width, source_height, run_length);
+  if (error) goto out;
 
   napi_value stretch_description;
   status = napi_create_string_utf8(env, "gif stretch", NAPI_AUTO_LENGTH, &stretch_description);
@@ -293,16 +1237,24 @@ napi_value stretch(napi_env env, napi_callback_info cbinfo) {
   baton->source_bottom = source_bottom;
   baton->source_width = source_width;
   baton->source_height = source_height;
-  baton->source_pixels = (unsigned char *)source_buffer;
+  if (run_length) {
+    baton->source_runs = (const rle_run *)source_buffer;
+    baton->source_row_starts = (const uint32_t *)row_starts;
+  } else {
+    baton->source_pixels = (unsigned char *)source_buffer;
+  }
   baton->result_width = result_width;
   baton->result_height = result_height;
-  baton->dest_pixels = (int *)dest_buffer;
+  baton->dest_pixels = dest_buffer;
+  baton->encoding = encoding;
   baton->filtered = filtered;
   baton->filtered_palette = (int *)filtered_palette;
   baton->unfiltered_palette = (int *)unfiltered_palette;
   baton->callback_ref = callback_ref;
   baton->dest_buffer_ref = dest_buffer_ref;
   baton->source_buffer_ref = source_buffer_ref;
+  baton->row_starts_buffer_ref = row_starts_buffer_ref;
+  baton->occupancy_buffer_ref = occupancy_buffer_ref;
   baton->unfiltered_palette_buffer_ref = unfiltered_palette_buffer_ref;
   baton->filtered_palette_buffer_ref = filtered_palette_buffer_ref;
   baton->work = work;
@@ -314,6 +1266,8 @@ napi_value stretch(napi_env env, napi_callback_info cbinfo) {
   work = nullptr;
   callback_ref = nullptr;
   source_buffer_ref = nullptr;
+  row_starts_buffer_ref = nullptr;
+  occupancy_buffer_ref = nullptr;
   dest_buffer_ref = nullptr;
   unfiltered_palette_buffer_ref = nullptr;
   filtered_palette_buffer_ref = nullptr;
@@ -321,6 +1275,8 @@ napi_value stretch(napi_env env, napi_callback_info cbinfo) {
 out:
   if (callback_ref) napi_delete_reference(env, callback_ref);
   if (source_buffer_ref) napi_delete_reference(env, source_buffer_ref);
+  if (row_starts_buffer_ref) napi_delete_reference(env, row_starts_buffer_ref);
+  if (occupancy_buffer_ref) napi_delete_reference(env, occupancy_buffer_ref);
   if (dest_buffer_ref) napi_delete_reference(env, dest_buffer_ref);
   if (unfiltered_palette_buffer_ref) napi_delete_reference(env, unfiltered_palette_buffer_ref);
   if (filtered_palette_buffer_ref) napi_delete_reference(env, filtered_palette_buffer_ref);
@@ -332,3 +1288,19 @@ out:
   }
   return nullptr;
 }
+
+napi_value stretch(napi_env env, napi_callback_info cbinfo) {
+  return queue_stretch(env, cbinfo, false, STRETCH_RAW);
+}
+
+napi_value stretch_rle(napi_env env, napi_callback_info cbinfo) {
+  return queue_stretch(env, cbinfo, true, STRETCH_RAW);
+}
+
+napi_value stretch_to_png(napi_env env, napi_callback_info cbinfo) {
+  return queue_stretch(env, cbinfo, false, STRETCH_PNG);
+}
+
+napi_value stretch_to_gif(napi_env env, napi_callback_info cbinfo) {
+  return queue_stretch(env, cbinfo, false, STRETCH_GIF);
+}
@@ -0,0 +1,143 @@
+#ifndef NODE_GIFBLOBBER_SRC_STRETCH_H
+#define NODE_GIFBLOBBER_SRC_STRETCH_H
+
+#include <node_api.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "rle.h"
+
+// How a zoomed-out stretch turns the source pixels under an output pixel
+// into one
+enum stretch_reduction {
+  STRETCH_NEAREST, // Samples one of them
+  STRETCH_MAX, // The highest index among them
+  STRETCH_MEAN // Their average index, rounded
+};
+
+// What stretch writes for each output pixel
+enum stretch_format {
+  STRETCH_RGBA, // The palette color, 4 bytes
+  STRETCH_BGRA, // The same with red and blue swapped
+  STRETCH_PREMULTIPLIED, // RGBA with the colors scaled by the alpha
+  STRETCH_RGB565, // The color as a native 16-bit 5:6:5 value, alpha dropped
+  STRETCH_INDEXED // The palette index, 1 byte
+};
+
+// What a stretch hands back
+enum stretch_encoding {
+  STRETCH_RAW, // Nothing; the pixels are in dest
+  STRETCH_PNG, // An indexed PNG
+  STRETCH_GIF // A GIF
+};
+
+struct stretch_baton {
+  double source_left;
+  double source_right;
+  double source_top;
+  double source_bottom;
+
+  int source_width;
+  int source_height;
+  unsigned char *source_pixels; // Dense, or else...
+  const rle_run *source_runs; // ...run-length encoded with these row starts
+  const uint32_t *source_row_starts;
+
+  // Which blocks of the source hold anything that can show (see
+  // occupancy.h), so that blank ones can be filled without being read, or
+  // null if that is not known
+  const unsigned char *occupancy;
+  
+  int result_width;
+  int result_height;
+  stretch_format format;
+  void *dest_pixels; // Pixels as format lays them out, row after row
+
+  // Render in one band on the calling thread, however large, for callers
+  // already spread over the pool themselves
+  bool single_band;
+
+  // How many of the pixels written show, i.e. are not fully transparent.
+  // Pixels outside the source are not written, so never count.
+  long long visible_pixels;
+
+  // stretchToPng and stretchToGif render palette indices into dest_pixels
+  // of their own and encode those, leaving encoded null and encode_error
+  // saying why if they cannot
+  stretch_encoding encoding;
+  unsigned char *encoded;
+  size_t encoded_length;
+  const char *encode_error;
+
+  int *filtered_palette;
+  int *unfiltered_palette;
+  
+  bool filtered;
+  stretch_reduction reduction;
+
+  // Output rows evenly spaced in Web Mercator rather than in source rows,
+  // for a source whose rows run from latitude north down to south
+  bool mercator;
+  double north;
+  double south;
+
+  napi_async_work work; // So we can delete when we are done
+  napi_ref callback_ref;
+  napi_ref dest_buffer_ref;
+  napi_ref source_buffer_ref;
+  napi_ref row_starts_buffer_ref;
+  napi_ref occupancy_buffer_ref;
+  napi_ref unfiltered_palette_buffer_ref;
+  napi_ref filtered_palette_buffer_ref;
+};
+
+/*
+ * Renders the stretch a baton describes into its dest_pixels, and sets its
+ * visible_pixels. Only the source and result fields, the format and the
+ * palettes are used.
+ */
+void render_stretch(stretch_baton *baton);
+
+/*
+ * The { covered, empty } stretches report: how many pixels show, and
+ * whether none do
+ */
+napi_status create_stretch_stats(napi_env env, long long visible_pixels, napi_value *stats);
+
+/*
+ * Reads the optional latitudes argument, { north, south }, that switches a
+ * stretch to Web Mercator. Returns an error message, or nullptr.
+ */
+const char *read_stretch_latitudes(napi_env env, napi_value latitudes, stretch_baton *baton);
+
+/*
+ * Reads the optional reduction argument: "nearest", "max" or "mean".
+ * Returns an error message, or nullptr.
+ */
+const char *read_stretch_reduction(napi_env env, napi_value reduction, stretch_baton *baton);
+
+/*
+ * Reads the optional format argument: "rgba", "bgra", "premultiplied",
+ * "rgb565" or "indexed". Returns an error message, or nullptr.
+ */
+const char *read_stretch_format(napi_env env, napi_value format, stretch_baton *baton);
+
+/*
+ * Reads the optional occupancy argument, the map of a width*height source
+ * that decoding produces, and takes a reference to it. Returns an error
+ * message, or nullptr.
+ */
+const char *read_stretch_occupancy(napi_env env, napi_value occupancy, int width, int height,
+                                   stretch_baton *baton, napi_ref *ref);
+
+// How many bytes each output pixel takes in a format
+int stretch_pixel_bytes(stretch_format format);
+
+/*
+ * Why a source of the given size cannot be stretched, or nullptr if it can.
+ * A run-length encoded source is checked run by run.
+ */
+const char *stretch_source_error(const void *source, size_t source_length,
+                                 const void *row_starts, size_t row_starts_length,
+                                 int width, int height, bool run_length);
+
+#endif
@@ -0,0 +1,33 @@
+var fs = require('fs');
+var crypto = require('crypto');
+var gifDecode = require('../lib/index').decode;
+var assert = require('assert');
+
+// SHA-1 of the pixels giflib's own DGifSlurp produced for each image, or
+// null where it rejected the file. The deferred* images never send a clear
+// code once the table is full, which exercises giflib's habit of redefining
+// code 4095 from then on.
+var expected = {
+  'anim.gif': '9ddcb592a98fdb358791623a55f9bdc59381624f',
+  'bits1.gif': '33c08ade631f145905653f68eba159e8f6c223b9',
+  'deferred0.gif': '5991856b05258929f6ed131d1d29b09626099a7b',
+  'deferred1.gif': null,
+  'deferred2.gif': 'be7caa4f998364fad037b285749715b397495e21',
+  'flat.gif': '165d3cc825476156a7d0e77958cdffae86c07cfe',
+  'noise256.gif': 'a2708ae786dea12e49588e4172f079967436e890',
+  'one.gif': '9842926af7ca0a8cca12604f945414f07b01e13d',
+  'radar.gif': '851ce3114d3b5ba3804f838652781391736222cc',
+  'radar_interlaced.gif': '851ce3114d3b5ba3804f838652781391736222cc'
+};
+
+Object.keys(expected).forEach(function(name) {
+  gifDecode(fs.readFileSync('./corpus/' + name), function(error, image) {
+    if (expected[name] === null) {
+      assert(error, name + ' should not decode');
+      return;
+    }
+    assert(!error, name + ': ' + error);
+    var digest = crypto.createHash('sha1').update(image.pixels).digest('hex');
+    assert.equal(digest, expected[name], name);
+  });
+});
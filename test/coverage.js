@@ -0,0 +1,128 @@
+var fs = require('fs');
+var gifblobber = require('../lib/index');
+var assert = require('assert');
+
+// Stretches report how many written pixels show. The radar palette has no
+// opaque colors, so prefilling with opaque white marks what was not
+// written.
+var views = [
+  [0, 1, 0, 1, 97, 61],
+  [0.4, 0.45, 0.3, 0.33, 120, 80],
+  [0.41, 0.44, 0.3, 0.34, 300, 200], // Quads big enough to count from their corners
+  [-0.2, 1.3, -0.1, 1.2, 150, 100],
+  [0.1, 0.9, 0.2, 0.7, 640, 512]
+];
+
+// Which checks ran to the end, looked at on the way out so that one whose
+// callback never comes fails rather than passing quietly
+var calls = {};
+function called(name) { calls[name] = (calls[name] || 0) + 1; }
+process.on('exit', function() {
+  ['dense', 'dense max', 'runs', 'off the image', 'opaque black', 'pyramid'].forEach(function(name) {
+    assert.equal(calls[name], 1, name + ' finished ' + (calls[name] || 0) + ' times');
+  });
+});
+
+function shown(rgba) {
+  var count = 0;
+  for (var i = 3; i < rgba.length; i += 4) {
+    if (rgba[i] != 0 && rgba[i] != 0xff) count++;
+  }
+  return count;
+}
+
+function check(image, options, done) {
+  var remaining = views.length;
+  views.forEach(function(view) {
+    var width = view[4], height = view[5];
+    var left = view[0] * image.width, right = view[1] * image.width;
+    var top = view[2] * image.height, bottom = view[3] * image.height;
+    var rgba = Buffer.alloc(width * height * 4, 0xff);
+    image.stretchWith(options, left, right, top, bottom, width, height, true, rgba, function(error, stats) {
+      assert(!error, error);
+      var name = JSON.stringify(options) + ' ' + JSON.stringify(view);
+      assert(stats.covered > 0, name);
+      assert.equal(stats.covered, shown(rgba), name);
+      assert.equal(stats.empty, false);
+
+      var indices = Buffer.alloc(width * height);
+      var sameOptions = Object.assign({ format: 'indexed' }, options);
+      image.stretchWith(sameOptions, left, right, top, bottom, width, height, true, indices, function(error, indexedStats) {
+        assert.deepEqual(indexedStats, stats, name);
+        image.stretchToPng(options, left, right, top, bottom, width, height, true, function(error, png, pngStats) {
+          assert.deepEqual(pngStats, stats, name);
+          if (--remaining == 0) done();
+        });
+      });
+    });
+  });
+}
+
+var bytes = fs.readFileSync('./corpus/radar.gif');
+gifblobber.decode(bytes, function(error, dense) {
+  assert(!error, error);
+  check(dense, {}, function() {
+    called('dense');
+    check(dense, { reduce: 'max' }, function() {
+      called('dense max');
+      gifblobber.decode(bytes, { rle: true }, function(error, runs) {
+        assert(!error, error);
+        check(runs, {}, function() {
+          called('runs');
+          // Off the image, nothing is written
+          dense.stretch(-200, -100, -200, -100, 64, 64, false, Buffer.alloc(64 * 64 * 4), function(error, stats) {
+            assert.deepEqual(stats, { covered: 0, empty: true });
+            called('off the image');
+            opaqueBlack(function() {
+              called('opaque black');
+              pyramid(dense);
+            });
+          });
+        });
+      });
+    });
+  });
+});
+
+// RGB565 has no alpha, and opaque black comes out as 0 just like a
+// transparent entry does; what shows is still told by the palette
+function opaqueBlack(done) {
+  var palette = Buffer.alloc(256 * 4);
+  for (var i = 10; i < 256; i++) palette.writeUInt32LE(0xff000000, i * 4);
+  var pixels = Buffer.alloc(64 * 64, 50);
+  pixels.fill(0, 0, 64 * 16); // The top quarter blanked out
+  var image = new gifblobber.BytePalettedImage(64, 64, pixels, palette, palette);
+
+  var remaining = 0;
+  [[0, 64, 0, 64, 32, 32], [0, 64, 0, 64, 512, 512]].forEach(function(view) {
+    remaining++;
+    var dest = Buffer.alloc(view[4] * view[5] * 2, 0xff);
+    image.stretchWith({ format: 'rgb565' }, view[0], view[1], view[2], view[3], view[4], view[5], true, dest, function(error, stats) {
+      assert(!error, error);
+      for (var i = 0; i < dest.length; i += 2) assert.equal(dest.readUInt16LE(i), 0);
+      var rgba = Buffer.alloc(view[4] * view[5] * 4);
+      image.stretch(view[0], view[1], view[2], view[3], view[4], view[5], true, rgba, function(error, rgbaStats) {
+        assert.deepEqual(stats, rgbaStats, JSON.stringify(view));
+        assert.equal(stats.empty, false);
+        assert(stats.covered > view[4] * view[5] / 2);
+        if (--remaining == 0) done();
+      });
+    });
+  });
+}
+
+function pyramid(image) {
+  var tiles = [];
+  gifblobber.renderPyramid(image, { minZoom: 4, maxZoom: 5, tileSize: 64, bounds: { left: 0.3, top: 0.3, right: 0.6, bottom: 0.5 } },
+                           function(error, batch) {
+    assert(!error, error);
+    if (batch) return tiles = tiles.concat(batch);
+    tiles.forEach(function(tile) {
+      assert.equal(tile.covered, shown(tile.pixels), tile.z + '/' + tile.x + '/' + tile.y);
+      assert.equal(tile.empty, tile.covered == 0);
+    });
+    assert(tiles.some(function(tile) { return tile.empty; }));
+    called('pyramid');
+    console.log('coverage ok');
+  });
+}
@@ -0,0 +1,33 @@
+var fs = require('fs');
+var gifblobber = require('../lib/index');
+var assert = require('assert');
+
+// How many times each decode called back, checked on the way out so that
+// one which never does fails rather than passing quietly
+var calls = {};
+process.on('exit', function() {
+  ['whole', 'rows', 'missing'].forEach(function(name) {
+    assert.equal(calls[name], 1, name + ' called back ' + (calls[name] || 0) + ' times');
+  });
+});
+
+gifblobber.decode(fs.readFileSync('./corpus/radar_interlaced.gif'), function(error, expected) {
+  assert(!error, error);
+  gifblobber.decodeFile('./corpus/radar_interlaced.gif', function(error, image) {
+    assert(!error, error);
+    assert.equal(image.width, expected.width);
+    assert.equal(image.height, expected.height);
+    assert.deepEqual(image.pixels, expected.pixels);
+    calls.whole = (calls.whole || 0) + 1;
+  });
+  gifblobber.decodeFile('./corpus/radar_interlaced.gif', { rows: 10 }, function(error, image) {
+    assert(!error, error);
+    assert.deepEqual(image.pixels, expected.pixels.slice(0, 10 * expected.width));
+    calls.rows = (calls.rows || 0) + 1;
+  });
+});
+
+gifblobber.decodeFile('./corpus/no-such-file.gif', function(error, image) {
+  calls.missing = (calls.missing || 0) + 1;
+  assert(error);
+});
@@ -0,0 +1,53 @@
+var fs = require('fs');
+var os = require('os');
+var gifblobber = require('../lib/index');
+var assert = require('assert');
+
+// Every format holds the same pixels as RGBA does, converted
+var formats = {
+  bgra: { bytes: 4, convert: function(r, g, b, a) { return [b, g, r, a]; } },
+  premultiplied: {
+    bytes: 4,
+    convert: function(r, g, b, a) {
+      return [r, g, b].map(function(c) { return Math.floor((c * a + 127) / 255); }).concat([a]);
+    }
+  },
+  rgb565: {
+    bytes: 2,
+    convert: function(r, g, b) {
+      var value = (r >> 3) << 11 | (g >> 2) << 5 | b >> 3;
+      return os.endianness() == 'LE' ? [value & 0xff, value >> 8] : [value >> 8, value & 0xff];
+    }
+  }
+};
+
+var views = [
+  [0, 1, 0, 1, 97, 61],
+  [0.4, 0.45, 0.3, 0.33, 120, 80],
+  [0.1, 0.9, 0.2, 0.7, 640, 512]
+];
+
+gifblobber.decode(fs.readFileSync('./corpus/radar.gif'), function(error, image) {
+  assert(!error, error);
+  var remaining = views.length * Object.keys(formats).length;
+  views.forEach(function(view) {
+    var width = view[4], height = view[5];
+    var left = view[0] * image.width, right = view[1] * image.width;
+    var top = view[2] * image.height, bottom = view[3] * image.height;
+    var rgba = Buffer.alloc(width * height * 4);
+    image.stretch(left, right, top, bottom, width, height, false, rgba, function() {
+      Object.keys(formats).forEach(function(name) {
+        var format = formats[name];
+        var dest = Buffer.alloc(width * height * format.bytes);
+        image.stretchWith({ format: name }, left, right, top, bottom, width, height, false, dest, function() {
+          for (var i = 0; i < width * height; i++) {
+            var expected = format.convert(rgba[i * 4], rgba[i * 4 + 1], rgba[i * 4 + 2], rgba[i * 4 + 3]);
+            assert.deepEqual(Array.from(dest.slice(i * format.bytes, (i + 1) * format.bytes)), expected,
+                             name + ' ' + JSON.stringify(view) + ' pixel ' + i);
+          }
+          if (--remaining == 0) console.log('formats ok');
+        });
+      });
+    });
+  });
+});
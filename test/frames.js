@@ -0,0 +1,45 @@
+var fs = require('fs');
+var gifblobber = require('../lib/index');
+var assert = require('assert');
+
+// An 8x6 loop exercising each disposal method, transparency, interlacing
+// and a frame hanging off the right edge of the screen
+var expected = [
+  '22222222' + '22222222' + '22222222' + '22222222' + '22222222' + '22222222',
+  '22222222' + '22323222' + '22332222' + '22222222' + '22222222' + '22222222',
+  '22222222' + '22000222' + '45450222' + '54542222' + '66662222' + '77772222',
+  '22222222' + '22000222' + '22000222' + '22222255' + '22222255' + '22222255'
+];
+
+// How many times each check's callback ran, checked on the way out so that
+// a decode which never calls back fails rather than passing quietly
+var calls = {};
+process.on('exit', function() {
+  ['disposal.gif', 'anim.gif'].forEach(function(name) {
+    assert.equal(calls[name], 1, name + ' called back ' + (calls[name] || 0) + ' times');
+  });
+});
+
+gifblobber.decodeFrames(fs.readFileSync('./corpus/disposal.gif'), function(error, frames) {
+  assert(!error, error);
+  assert.equal(frames.length, expected.length);
+  frames.forEach(function(frame, i) {
+    assert.equal(frame.width, 8);
+    assert.equal(frame.height, 6);
+    assert.equal(Array.prototype.join.call(frame.pixels, ''), expected[i], 'frame ' + i);
+  });
+  assert.deepEqual(frames.map(function(frame) { return frame.delay; }), [5, 7, 9, 0]);
+  calls['disposal.gif'] = (calls['disposal.gif'] || 0) + 1;
+});
+
+// The first composited frame is what decode() gives
+var anim = fs.readFileSync('./corpus/anim.gif');
+gifblobber.decode(anim, function(error, first) {
+  assert(!error, error);
+  gifblobber.decodeFrames(anim, function(error, frames) {
+    assert(!error, error);
+    assert.equal(frames.length, 3);
+    assert.deepEqual(frames[0].pixels, first.pixels);
+    calls['anim.gif'] = (calls['anim.gif'] || 0) + 1;
+  });
+});
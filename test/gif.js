@@ -0,0 +1,69 @@
+var fs = require('fs');
+var gifblobber = require('../lib/index');
+var assert = require('assert');
+
+// A GIF of a stretch decodes back to its indices, with everything
+// transparent, including pixels outside the source, as one transparent
+// index
+var identity = Buffer.alloc(256 * 4);
+for (var i = 0; i < 256; i++) identity.writeUInt32LE(i, i * 4);
+
+var views = [
+  [0, 1, 0, 1, 97, 61],
+  [0.4, 0.45, 0.3, 0.33, 120, 80],
+  [-0.2, 1.3, -0.1, 1.2, 150, 100],
+  [-2, -1, -2, -1, 40, 30] // Nothing but transparency
+];
+
+function check(image, done) {
+  var remaining = views.length;
+  views.forEach(function(view) {
+    var width = view[4], height = view[5];
+    var left = view[0] * image.width, right = view[1] * image.width;
+    var top = view[2] * image.height, bottom = view[3] * image.height;
+    var indices = Buffer.alloc(width * height * 4, 0xff);
+    var asIndices = Object.create(image);
+    asIndices.unfiltered_palette = asIndices.filtered_palette = identity;
+    asIndices.stretch(left, right, top, bottom, width, height, false, indices, function() {
+      image.stretchToGif(left, right, top, bottom, width, height, false, function(error, gif) {
+        assert(!error, error);
+        assert.equal(gif.toString('ascii', 0, 6), 'GIF89a');
+        gifblobber.decode(gif, function(error, decoded) {
+          assert(!error, error);
+          assert.equal(decoded.width, width);
+          assert.equal(decoded.height, height);
+          var transparent = -1;
+          for (var i = 0; i < width * height; i++) {
+            var expected = indices.readInt32LE(i * 4);
+            var actual = decoded.pixels[i];
+            if (expected < 0 || image.unfiltered_palette[expected * 4 + 3] == 0) {
+              if (transparent < 0) transparent = actual;
+              assert.equal(actual, transparent, JSON.stringify(view) + ' pixel ' + i);
+            } else {
+              assert.equal(actual, expected, JSON.stringify(view) + ' pixel ' + i);
+            }
+          }
+          if (--remaining == 0) done();
+        });
+      });
+    });
+  });
+}
+
+var bytes = fs.readFileSync('./corpus/radar.gif');
+gifblobber.decode(bytes, function(error, dense) {
+  assert(!error, error);
+  check(dense, function() {
+    gifblobber.decode(bytes, { rle: true }, function(error, runs) {
+      assert(!error, error);
+      check(runs, function() {
+        // A tile with nothing in it is tiny
+        dense.stretchToGif(-2, -1, -2, -1, 256, 256, false, function(error, gif) {
+          assert(!error, error);
+          assert(gif.length < 100, gif.length);
+          console.log('gif ok');
+        });
+      });
+    });
+  });
+});
@@ -0,0 +1,67 @@
+var fs = require('fs');
+var gifblobber = require('../lib/index');
+var assert = require('assert');
+
+// Indexed output is what a palette mapping every index to itself gives
+var identity = Buffer.alloc(256 * 4);
+for (var i = 0; i < 256; i++) identity.writeUInt32LE(i, i * 4);
+
+var views = [
+  [0, 1, 0, 1, 97, 61],
+  [0.4, 0.45, 0.3, 0.33, 120, 80],
+  [-0.2, 1.3, -0.1, 1.2, 150, 100],
+  [0.1, 0.9, 0.2, 0.7, 640, 512] // Large enough to be split across threads
+];
+
+function check(image, options, done) {
+  var remaining = views.length * 2;
+  views.forEach(function(view) {
+    [false, true].forEach(function(filtered) {
+      var width = view[4], height = view[5];
+      var left = view[0] * image.width, right = view[1] * image.width;
+      var top = view[2] * image.height, bottom = view[3] * image.height;
+      var colors = Buffer.alloc(width * height * 4, 0xff), indices = Buffer.alloc(width * height, 0xff);
+      var asIndices = Object.create(image);
+      asIndices.unfiltered_palette = asIndices.filtered_palette = identity;
+      asIndices.stretchWith(options, left, right, top, bottom, width, height, filtered, colors, function() {
+        image.stretchWith(Object.assign({ format: 'indexed' }, options), left, right, top, bottom, width, height, filtered, indices, function() {
+          for (var i = 0; i < width * height; i++) {
+            var expected = colors.readInt32LE(i * 4);
+            assert.equal(indices[i], expected < 0 ? 0xff : expected, JSON.stringify(view) + ' pixel ' + i);
+          }
+          if (--remaining == 0) done();
+        });
+      });
+    });
+  });
+}
+
+var bytes = fs.readFileSync('./corpus/radar.gif');
+gifblobber.decode(bytes, function(error, dense) {
+  assert(!error, error);
+  check(dense, {}, function() {
+    check(dense, { reduce: 'mean' }, function() {
+      gifblobber.decode(bytes, { rle: true }, function(error, runs) {
+        assert(!error, error);
+        check(runs, { latitudes: { north: 60, south: 20 } }, function() {
+          assert.throws(function() {
+            dense.stretchWith({ format: 'indexed' }, 0, 1, 0, 1, 4, 4, false, Buffer.alloc(64), function() {});
+          }, /Buffer length/);
+          pyramid(dense);
+        });
+      });
+    });
+  });
+});
+
+// Pyramid tiles can be indexed too
+function pyramid(image) {
+  var tiles = [];
+  gifblobber.renderPyramid(image, { maxZoom: 1, tileSize: 32, format: 'indexed' }, function(error, batch) {
+    assert(!error, error);
+    if (batch) return tiles = tiles.concat(batch);
+    assert.equal(tiles.length, 5);
+    tiles.forEach(function(tile) { assert.equal(tile.pixels.length, 32 * 32); });
+    console.log('indexed ok');
+  });
+}
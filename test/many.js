@@ -0,0 +1,38 @@
+var fs = require('fs');
+var gifblobber = require('../lib/index');
+var assert = require('assert');
+
+var names = ['radar.gif', 'deferred1.gif', 'one.gif', 'anim.gif'];
+var buffers = names.map(function(name) { return fs.readFileSync('./corpus/' + name); });
+
+// How many times each check's callback ran, checked on the way out so that
+// one which never calls back fails rather than passing quietly
+var calls = {};
+process.on('exit', function() {
+  ['radar.gif', 'one.gif', 'anim.gif', 'empty'].forEach(function(name) {
+    assert.equal(calls[name], 1, name + ' called back ' + (calls[name] || 0) + ' times');
+  });
+});
+
+gifblobber.decodeMany(buffers, function(error, results) {
+  assert(!error, error);
+  assert.equal(results.length, names.length);
+  assert(results[1] instanceof Error, 'deferred1.gif should not decode');
+
+  [0, 2, 3].forEach(function(i) {
+    gifblobber.decode(buffers[i], function(error, expected) {
+      assert(!error, error);
+      assert.equal(results[i].width, expected.width);
+      assert.equal(results[i].height, expected.height);
+      assert.deepEqual(results[i].pixels, expected.pixels, names[i]);
+      assert.deepEqual(results[i].unfiltered_palette, expected.unfiltered_palette);
+      calls[names[i]] = (calls[names[i]] || 0) + 1;
+    });
+  });
+});
+
+gifblobber.decodeMany([], function(error, results) {
+  assert(!error, error);
+  assert.equal(results.length, 0);
+  calls.empty = (calls.empty || 0) + 1;
+});
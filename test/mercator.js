@@ -0,0 +1,78 @@
+var gifblobber = require('../lib/index');
+var assert = require('assert');
+
+// A 360x180 source on a one-degree grid, from 90N down to 90S
+var width = 360, height = 180;
+var latitudes = { north: 90, south: -90 };
+var palette = Buffer.alloc(256 * 4);
+for (var i = 0; i < 256; i++) palette.writeUInt32LE(i, i * 4);
+
+function mercatorY(latitude) {
+  return Math.log(Math.tan(Math.PI / 4 + latitude * Math.PI / 360));
+}
+
+function mercatorLatitude(y) {
+  return Math.atan(Math.sinh(y)) * 180 / Math.PI;
+}
+
+// Zoomed out every output row is one source row, chosen through the
+// projection: row i of the source holds index i
+var rows = Buffer.alloc(width * height);
+for (var y = 0; y < height; y++) rows.fill(y, y * width, (y + 1) * width);
+
+var top = 20, bottom = 160, outWidth = 100, outHeight = 300;
+var dest = Buffer.alloc(outWidth * outHeight * 4);
+gifblobber.raw.stretch(rows, width, height, palette, palette, 0, width, top, bottom, outWidth, outHeight, false, dest, function() {
+  var yTop = mercatorY(90 - top), yBottom = mercatorY(90 - bottom);
+  for (var outY = 0; outY < outHeight; outY++) {
+    var expected = Math.floor(90 - mercatorLatitude(yTop + (yBottom - yTop) * outY / outHeight));
+    assert.equal(dest.readUInt32LE(outY * outWidth * 4), expected, 'row ' + outY);
+    assert.equal(dest.readUInt32LE(((outY + 1) * outWidth - 1) * 4), expected, 'row ' + outY);
+  }
+  zoomedIn();
+}, latitudes);
+
+// Zoomed in, a source row's top lands where the projection puts it: above
+// row 60 the source is blanked out, below it solid
+function zoomedIn() {
+  var edge = Buffer.alloc(width * height, 0);
+  edge.fill(22, 60 * width);
+
+  var top = 40, bottom = 80, outWidth = 1000, outHeight = 400;
+  var dest = Buffer.alloc(outWidth * outHeight * 4);
+  gifblobber.raw.stretch(edge, width, height, palette, palette, 100, 110, top, bottom, outWidth, outHeight, false, dest, function() {
+    var yTop = mercatorY(90 - top), yBottom = mercatorY(90 - bottom);
+    var solidFrom = Math.floor((mercatorY(90 - 60) - yTop) / (yBottom - yTop) * outHeight);
+    assert.notEqual(dest.readUInt32LE((solidFrom - 1) * outWidth * 4), 22);
+    assert.equal(dest.readUInt32LE(solidFrom * outWidth * 4), 22);
+    assert.equal(dest.readUInt32LE((outHeight - 1) * outWidth * 4), 22);
+    pyramid();
+  }, latitudes);
+}
+
+// A Mercator pyramid's tiles are stretches of their latitude spans
+function pyramid() {
+  var image = { pixels: rows, width: width, height: height, unfiltered_palette: palette, filtered_palette: palette };
+  var tiles = [];
+  gifblobber.renderPyramid(image, { minZoom: 1, maxZoom: 2, tileSize: 64, latitudes: latitudes }, function(error, batch) {
+    assert(!error, error);
+    if (batch) return tiles = tiles.concat(batch);
+
+    assert.equal(tiles.length, 4 + 16); // The whole world at both zooms
+    var remaining = tiles.length;
+    tiles.forEach(function(tile) {
+      var across = 1 << tile.z;
+      function sourceRow(fraction) {
+        return 90 - mercatorLatitude(Math.PI * (1 - 2 * fraction));
+      }
+      var expected = Buffer.alloc(64 * 64 * 4);
+      gifblobber.raw.stretch(rows, width, height, palette, palette,
+                             tile.x / across * width, (tile.x + 1) / across * width,
+                             sourceRow(tile.y / across), sourceRow((tile.y + 1) / across),
+                             64, 64, false, expected, function() {
+        assert(tile.pixels.equals(expected), tile.z + '/' + tile.x + '/' + tile.y);
+        if (--remaining == 0) console.log('mercator ok');
+      }, latitudes);
+    });
+  });
+}
@@ -0,0 +1,104 @@
+var fs = require('fs');
+var gifblobber = require('../lib/index');
+var assert = require('assert');
+
+var palette = Buffer.alloc(256 * 4);
+for (var i = 0; i < 256; i++) palette.writeUInt32LE(i, i * 4);
+
+// Each level is the maximum of 2x2 blocks of the one above, odd edges
+// included, down to a single pixel
+var width = 37, height = 23;
+var pixels = Buffer.alloc(width * height);
+for (var i = 0; i < pixels.length; i++) pixels[i] = (i * 7919 + (i >> 3) * 13) & 255;
+var synthetic = new gifblobber.BytePalettedImage(width, height, pixels, palette, palette);
+
+// Which checks ran to the end, looked at on the way out so that one whose
+// callback never comes fails rather than passing quietly
+var calls = {};
+process.on('exit', function() {
+  ['levels', 'run length', 'stretching'].forEach(function(name) {
+    assert.equal(calls[name], 1, name + ' finished ' + (calls[name] || 0) + ' times');
+  });
+});
+
+synthetic.buildMipmaps(function(error) {
+  assert(!error, error);
+  var above = { width: width, height: height, pixels: pixels };
+  synthetic.mipmaps.forEach(function(level) {
+    assert.equal(level.width, Math.ceil(above.width / 2));
+    assert.equal(level.height, Math.ceil(above.height / 2));
+    for (var y = 0; y < level.height; y++) {
+      for (var x = 0; x < level.width; x++) {
+        var highest = 0;
+        for (var dy = 0; dy < 2; dy++) {
+          for (var dx = 0; dx < 2; dx++) {
+            var ax = 2 * x + dx, ay = 2 * y + dy;
+            if (ax < above.width && ay < above.height) highest = Math.max(highest, above.pixels[ay * above.width + ax]);
+          }
+        }
+        assert.equal(level.pixels[y * level.width + x], highest);
+      }
+    }
+    above = level;
+  });
+  assert.equal(above.width, 1);
+  assert.equal(above.height, 1);
+  calls.levels = (calls.levels || 0) + 1;
+  runLength();
+});
+
+// Run-length images give the same levels
+function runLength() {
+  var bytes = fs.readFileSync('./corpus/radar.gif');
+  gifblobber.decode(bytes, function(error, dense) {
+    assert(!error, error);
+    gifblobber.decode(bytes, { rle: true }, function(error, runs) {
+      assert(!error, error);
+      dense.buildMipmaps(function(error) {
+        assert(!error, error);
+        runs.buildMipmaps(function(error) {
+          assert(!error, error);
+          assert.equal(runs.mipmaps.length, dense.mipmaps.length);
+          dense.mipmaps.forEach(function(level, i) {
+            assert(runs.mipmaps[i].pixels.equals(level.pixels), 'level ' + i);
+          });
+          calls['run length'] = (calls['run length'] || 0) + 1;
+          stretching();
+        });
+      });
+    });
+  });
+}
+
+// Shrinking fourfold reads the quarter-size level, and a lone hot pixel
+// that sampling the full image misses shows up
+function stretching() {
+  var hotPixels = Buffer.alloc(1024 * 1024, 6);
+  hotPixels[517 * 1024 + 263] = 200;
+  var hot = new gifblobber.BytePalettedImage(1024, 1024, hotPixels, palette, palette);
+
+  var full = Buffer.alloc(256 * 256 * 4), mipmapped = Buffer.alloc(256 * 256 * 4);
+  hot.stretch(0, 1024, 0, 1024, 256, 256, false, full, function() {
+    hot.buildMipmaps(function(error) {
+      assert(!error, error);
+      hot.stretch(0, 1024, 0, 1024, 256, 256, false, mipmapped, function() {
+        var expected = Buffer.alloc(256 * 256 * 4);
+        var level = hot.mipmaps[1];
+        gifblobber.raw.stretch(level.pixels, level.width, level.height, palette, palette, 0, 256, 0, 256,
+                               256, 256, false, expected, function() {
+          assert(mipmapped.equals(expected));
+          assert.equal(full.readUInt32LE((129 * 256 + 65) * 4), 6);
+          assert.equal(mipmapped.readUInt32LE((129 * 256 + 65) * 4), 200);
+
+          // Unless told not to
+          var unmipped = Buffer.alloc(256 * 256 * 4);
+          hot.stretchWith({ mipmaps: false }, 0, 1024, 0, 1024, 256, 256, false, unmipped, function() {
+            assert(unmipped.equals(full));
+            calls.stretching = (calls.stretching || 0) + 1;
+            console.log('mipmap ok');
+          });
+        });
+      });
+    });
+  });
+}
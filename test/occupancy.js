@@ -0,0 +1,124 @@
+var fs = require('fs');
+var gifblobber = require('../lib/index');
+var assert = require('assert');
+
+// A byte per 16x16 block: 1 if anything is above 6, 2 if above 9
+function reference(pixels, width, height) {
+  var columns = Math.ceil(width / 16), rows = Math.ceil(height / 16);
+  var map = Buffer.alloc(columns * rows);
+  for (var y = 0; y < height; y++) {
+    for (var x = 0; x < width; x++) {
+      var level = pixels[y * width + x];
+      var block = (y >> 4) * columns + (x >> 4);
+      if (level > 6) map[block] |= 1;
+      if (level > 9) map[block] |= 2;
+    }
+  }
+  return map;
+}
+
+// Which checks ran to the end, looked at on the way out so that one whose
+// callback never comes fails rather than passing quietly
+var calls = {};
+function called(name) { calls[name] = (calls[name] || 0) + 1; }
+process.on('exit', function() {
+  ['frames', 'dense', 'runs', 'blank blocks'].forEach(function(name) {
+    assert.equal(calls[name], 1, name + ' finished ' + (calls[name] || 0) + ' times');
+  });
+});
+
+var bytes = fs.readFileSync('./corpus/radar.gif');
+gifblobber.decode(bytes, function(error, dense) {
+  assert(!error, error);
+  assert(dense.occupancy.equals(reference(dense.pixels, dense.width, dense.height)));
+  gifblobber.decode(bytes, { rle: true }, function(error, runs) {
+    assert(!error, error);
+    assert(runs.occupancy.equals(dense.occupancy));
+    gifblobber.decodeFrames(fs.readFileSync('./corpus/anim.gif'), function(error, frames) {
+      assert(!error, error);
+      frames.forEach(function(frame, i) {
+        assert(frame.occupancy.equals(reference(frame.pixels, frame.width, frame.height)), 'frame ' + i);
+      });
+      called('frames');
+      sameWithout(dense, function() {
+        called('dense');
+        sameWithout(runs, function() {
+          called('runs');
+          ignoresBlankBlocks();
+        });
+      });
+    });
+  });
+});
+
+// Stretches come out the same with the map as without it
+function sameWithout(image, callback) {
+  var views = [
+    [0, image.width, 0, image.height, 100, 80],
+    [image.width * 0.4, image.width * 0.45, image.height * 0.3, image.height * 0.34, 300, 200],
+    [-20, 40, -10, 30, 256, 256], // Off the top left corner, where it is empty
+    [image.width * 0.1, image.width * 0.9, image.height * 0.2, image.height * 0.25, 400, 300]
+  ];
+  var occupancy = image.occupancy;
+  var checks = [];
+  views.forEach(function(view) {
+    [false, true].forEach(function(filtered) {
+      [null, 'indexed', 'png'].forEach(function(format) {
+        checks.push({ view: view, filtered: filtered, format: format });
+      });
+    });
+  });
+
+  (function next() {
+    var check = checks.shift();
+    if (!check) {
+      image.occupancy = occupancy;
+      return callback();
+    }
+    var view = check.view;
+    function render(done) {
+      if (check.format == 'png') {
+        return image.stretchToPng(view[0], view[1], view[2], view[3], view[4], view[5], check.filtered, function(error, png, stats) {
+          done(png, stats);
+        });
+      }
+      var dest = Buffer.alloc(view[4] * view[5] * (check.format ? 1 : 4), 0xee);
+      image.stretchWith({ format: check.format }, view[0], view[1], view[2], view[3], view[4], view[5], check.filtered, dest, function(error, stats) {
+        done(dest, stats);
+      });
+    }
+
+    image.occupancy = occupancy;
+    render(function(mapped, mappedStats) {
+      image.occupancy = null;
+      render(function(unmapped, stats) {
+        var label = JSON.stringify(check);
+        assert(mapped.equals(unmapped), label);
+        assert.deepEqual(mappedStats, stats, label);
+        next();
+      });
+    });
+  })();
+}
+
+// A block the map calls empty is filled blank without being read, and a
+// map of the wrong size is refused
+function ignoresBlankBlocks() {
+  var palette = Buffer.alloc(256 * 4);
+  for (var i = 0; i < 256; i++) palette.writeUInt32LE(i <= 9 ? 0 : i, i * 4);
+  var width = 40, height = 40;
+  var pixels = Buffer.alloc(width * height, 50);
+  var empty = Buffer.alloc(9);
+
+  var dest = Buffer.alloc(64 * 64 * 4, 0xee);
+  gifblobber.raw.stretch(pixels, width, height, palette, palette, 0, 8, 0, 8, 64, 64, false, dest, function() {
+    for (var i = 0; i < 64 * 64; i++) assert.equal(dest.readUInt32LE(i * 4), 0, 'pixel ' + i);
+
+    assert.throws(function() {
+      gifblobber.raw.stretch(pixels, width, height, palette, palette, 0, 8, 0, 8, 64, 64, false, dest, function() {},
+                             null, null, null, Buffer.alloc(4));
+    }, /Occupancy map does not match the source/);
+    called('blank blocks');
+    console.log('occupancy ok');
+  }, null, null, null, empty);
+}
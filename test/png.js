@@ -0,0 +1,116 @@
+var fs = require('fs');
+var zlib = require('zlib');
+var gifblobber = require('../lib/index');
+var assert = require('assert');
+
+// The RGBA pixels of an indexed PNG, as stretch would write them
+function decodePng(png) {
+  assert(png.slice(0, 8).equals(Buffer.from([0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a])));
+  var chunks = [], idat = [];
+  for (var at = 8; at < png.length; ) {
+    var length = png.readUInt32BE(at), type = png.toString('ascii', at + 4, at + 8);
+    var data = png.slice(at + 8, at + 8 + length);
+    assert.equal(png.readUInt32BE(at + 8 + length), zlib.crc32(png.slice(at + 4, at + 8 + length)), type + ' crc');
+    chunks.push(type);
+    if (type == 'IHDR') var header = data;
+    if (type == 'PLTE') var plte = data;
+    if (type == 'tRNS') var trns = data;
+    if (type == 'IDAT') idat.push(data);
+    at += 12 + length;
+  }
+  assert.equal(chunks[0], 'IHDR');
+  assert.equal(chunks[chunks.length - 1], 'IEND');
+  assert.equal(header[8], 8);
+  assert.equal(header[9], 3);
+
+  var width = header.readUInt32BE(0), height = header.readUInt32BE(4);
+  var rows = zlib.inflateSync(Buffer.concat(idat));
+  assert.equal(rows.length, (width + 1) * height);
+  var pixels = Buffer.alloc(width * height * 4);
+  for (var y = 0; y < height; y++) {
+    assert.equal(rows[y * (width + 1)], 0);
+    for (var x = 0; x < width; x++) {
+      var index = rows[y * (width + 1) + 1 + x], out = (y * width + x) * 4;
+      assert(index * 3 < plte.length, 'index past the palette');
+      plte.copy(pixels, out, index * 3, index * 3 + 3);
+      pixels[out + 3] = trns && index < trns.length ? trns[index] : 0xff;
+    }
+  }
+  return { width: width, height: height, pixels: pixels };
+}
+
+// Zoomed out, zoomed in, and reaching past the image on every side
+var views = [
+  [0, 1, 0, 1, 97, 61],
+  [0.4, 0.45, 0.3, 0.33, 120, 80],
+  [-0.2, 1.3, -0.1, 1.2, 150, 100]
+];
+
+function check(image, options, done) {
+  var remaining = views.length * 2;
+  views.forEach(function(view) {
+    [false, true].forEach(function(filtered) {
+      var width = view[4], height = view[5];
+      var left = view[0] * image.width, right = view[1] * image.width;
+      var top = view[2] * image.height, bottom = view[3] * image.height;
+      var expected = Buffer.alloc(width * height * 4, 0xff);
+      image.stretchWith(options, left, right, top, bottom, width, height, filtered, expected, function() {
+        image.stretchToPng(options, left, right, top, bottom, width, height, filtered, function(error, png) {
+          assert(!error, error);
+          var decoded = decodePng(png);
+          assert.equal(decoded.width, width);
+          assert.equal(decoded.height, height);
+          for (var i = 0; i < width * height; i++) {
+            var wanted = expected.readUInt32LE(i * 4);
+            var actual = decoded.pixels.readUInt32LE(i * 4);
+            // Untouched pixels only need to be transparent
+            if (wanted == 0xffffffff) assert.equal(actual >>> 24, 0, JSON.stringify(view) + ' pixel ' + i);
+            else assert.equal(actual, wanted, JSON.stringify(view) + ' pixel ' + i);
+          }
+          if (--remaining == 0) done();
+        });
+      });
+    });
+  });
+}
+
+var bytes = fs.readFileSync('./corpus/radar.gif');
+gifblobber.decode(bytes, function(error, dense) {
+  assert(!error, error);
+  check(dense, {}, function() {
+    gifblobber.decode(bytes, { rle: true }, function(error, runs) {
+      assert(!error, error);
+      check(runs, { reduce: 'max' }, function() {
+        // Options can be left out
+        dense.stretchToPng(0, dense.width, 0, dense.height, 16, 16, false, function(error, png) {
+          assert(!error, error);
+          assert.equal(decodePng(png).width, 16);
+          fullPalette();
+        });
+      });
+    });
+  });
+});
+
+// With every index opaque and in use, none is free to be transparent for
+// pixels outside the source, and that is an error rather than a recolor
+function fullPalette() {
+  var palette = Buffer.alloc(256 * 4);
+  for (var i = 0; i < 256; i++) palette.writeUInt32LE((0xff000000 | i * 0x010101) >>> 0, i * 4);
+  var pixels = Buffer.alloc(16 * 16);
+  for (var i = 0; i < 256; i++) pixels[i] = i;
+  var image = new gifblobber.BytePalettedImage(16, 16, pixels, palette, palette);
+
+  image.stretchToPng(0, 16, 0, 16, 16, 16, false, function(error, png) {
+    assert(!error, error);
+    var decoded = decodePng(png);
+    for (var i = 0; i < 256; i++) assert.equal(decoded.pixels.readUInt32LE(i * 4), palette.readUInt32LE(i * 4));
+
+    image.stretchToPng(-4, 20, 0, 16, 24, 16, false, function(error, png) {
+      assert(error instanceof Error);
+      assert(/No palette index is left/.test(error.message), error.message);
+      assert.equal(png, undefined);
+      console.log('png ok');
+    });
+  });
+}
@@ -0,0 +1,13 @@
+var fs = require('fs');
+var gifblobber = require('../lib/index');
+var assert = require('assert');
+
+var info = gifblobber.probe(fs.readFileSync('./corpus/anim.gif'));
+assert.equal(info.width, 200);
+assert.equal(info.height, 150);
+assert.equal(info.frameCount, 3);
+assert.equal(info.palette.length, 256 * 3);
+
+assert.throws(function() {
+  gifblobber.probe(Buffer.from('GIF89a'));
+});
@@ -0,0 +1,67 @@
+var fs = require('fs');
+var gifblobber = require('../lib/index');
+var assert = require('assert');
+
+var bytes = fs.readFileSync('./corpus/radar.gif');
+var bounds = { left: 0.3, top: 0.2, right: 0.7, bottom: 0.5 };
+var tileSize = 64;
+
+function collect(image, callback) {
+  var tiles = {};
+  var batches = 0;
+  gifblobber.renderPyramid(image, { minZoom: 0, maxZoom: 4, tileSize: tileSize, bounds: bounds }, function(error, batch) {
+    assert(!error, error);
+    if (!batch) return callback(tiles, batches);
+    batches++;
+    batch.forEach(function(tile) {
+      var key = tile.z + '/' + tile.x + '/' + tile.y;
+      assert(!tiles[key], 'tile sent twice: ' + key);
+      tiles[key] = tile.pixels;
+    });
+  });
+}
+
+// Every tile must be what a stretch of its part of the world gives
+gifblobber.decode(bytes, function(error, dense) {
+  assert(!error, error);
+  collect(dense, function(tiles, batches) {
+    var expectedCount = 0;
+    for (var z = 0; z <= 4; z++) {
+      var across = 1 << z;
+      var xs = Math.ceil(bounds.right * across) - Math.floor(bounds.left * across);
+      var ys = Math.ceil(bounds.bottom * across) - Math.floor(bounds.top * across);
+      expectedCount += xs * ys;
+    }
+    assert.equal(Object.keys(tiles).length, expectedCount);
+    assert(batches >= 1);
+
+    var xScale = dense.width / (bounds.right - bounds.left);
+    var yScale = dense.height / (bounds.bottom - bounds.top);
+    var remaining = expectedCount;
+    Object.keys(tiles).forEach(function(key) {
+      var parts = key.split('/').map(Number);
+      var across = Math.pow(2, parts[0]);
+      var expected = Buffer.alloc(tileSize * tileSize * 4);
+      dense.stretch((parts[1] / across - bounds.left) * xScale, ((parts[1] + 1) / across - bounds.left) * xScale,
+                    (parts[2] / across - bounds.top) * yScale, ((parts[2] + 1) / across - bounds.top) * yScale,
+                    tileSize, tileSize, false, expected, function() {
+        assert(tiles[key].equals(expected), key);
+        if (--remaining == 0) checkRunLength(tiles);
+      });
+    });
+  });
+});
+
+// The run-length form renders the same tiles
+function checkRunLength(denseTiles) {
+  gifblobber.decode(bytes, { rle: true }, function(error, runs) {
+    assert(!error, error);
+    collect(runs, function(tiles) {
+      assert.deepEqual(Object.keys(tiles).sort(), Object.keys(denseTiles).sort());
+      Object.keys(tiles).forEach(function(key) {
+        assert(tiles[key].equals(denseTiles[key]), key);
+      });
+      console.log('pyramid ok');
+    });
+  });
+}
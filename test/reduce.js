@@ -0,0 +1,112 @@
+var fs = require('fs');
+var gifblobber = require('../lib/index');
+var assert = require('assert');
+
+var palette = Buffer.alloc(256 * 4);
+for (var i = 0; i < 256; i++) palette.writeUInt32LE(i, i * 4);
+
+// What a reduction should give, following stretch's own footprints
+function reference(pixels, width, height, left, right, top, bottom, outWidth, outHeight, reduce) {
+  var step = Math.trunc((right - left) / outWidth * 32768 + .5);
+  var initial = Math.trunc(left * 32768 + .5);
+  function column(x) { return Math.floor((initial + x * step) / 32768); }
+  function row(y) { return Math.trunc(y * (bottom - top) / outHeight + top); }
+
+  var result = [];
+  for (var outY = 0; outY < outHeight; outY++) {
+    var y1 = row(outY), y2 = Math.min(height, Math.max(y1 + 1, row(outY + 1)));
+    for (var outX = 0; outX < outWidth; outX++) {
+      var x1 = column(outX), x2 = Math.min(width, Math.max(x1 + 1, column(outX + 1)));
+      if (y1 < 0 || y1 >= height || x1 < 0 || x1 >= width) {
+        result.push(-1);
+        continue;
+      }
+      var highest = 0, total = 0;
+      for (var y = y1; y < y2; y++) {
+        for (var x = x1; x < x2; x++) {
+          highest = Math.max(highest, pixels[y * width + x]);
+          total += pixels[y * width + x];
+        }
+      }
+      var count = (y2 - y1) * (x2 - x1);
+      result.push(reduce == 'max' ? highest : Math.floor((total + Math.floor(count / 2)) / count));
+    }
+  }
+  return result;
+}
+
+var width = 333, height = 211;
+var pixels = Buffer.alloc(width * height);
+for (var i = 0; i < pixels.length; i++) pixels[i] = (i * 7919 + (i >> 5) * 31) & 255;
+
+// How many times each check's callback ran, checked on the way out so that
+// a stretch which never calls back fails rather than passing quietly
+var calls = {};
+function called(name) { calls[name] = (calls[name] || 0) + 1; }
+process.on('exit', function() {
+  var names = ['hot pixel', 'run-length max', 'run-length mean'];
+  ['max', 'mean'].forEach(function(reduce) {
+    views.forEach(function(view) { names.push(reduce + ' ' + JSON.stringify(view)); });
+  });
+  names.forEach(function(name) {
+    assert.equal(calls[name], 1, name + ' called back ' + (calls[name] || 0) + ' times');
+  });
+});
+
+var views = [
+  [0, width, 0, height, 40, 30],
+  [-50, 400, 20, 190, 77, 41],
+  [10, 300, -30, 250, 120, 200], // Taller output than source: rows repeat
+  [0, width, 0, height, 1, 1]
+];
+
+var pending = 0;
+['max', 'mean'].forEach(function(reduce) {
+  views.forEach(function(view) {
+    var outWidth = view[4], outHeight = view[5];
+    var dest = Buffer.alloc(outWidth * outHeight * 4, 0xff);
+    pending++;
+    gifblobber.raw.stretch(pixels, width, height, palette, palette, view[0], view[1], view[2], view[3],
+                           outWidth, outHeight, false, dest, function() {
+      var expected = reference(pixels, width, height, view[0], view[1], view[2], view[3], outWidth, outHeight, reduce);
+      for (var i = 0; i < expected.length; i++) {
+        assert.equal(dest.readInt32LE(i * 4), expected[i], reduce + ' ' + JSON.stringify(view) + ' pixel ' + i);
+      }
+      called(reduce + ' ' + JSON.stringify(view));
+      if (--pending == 0) checkRunLength();
+    }, null, reduce);
+  });
+});
+
+// A lone hot pixel survives zooming far out with max, where sampling
+// loses it
+var blank = Buffer.alloc(1000 * 1000, 6);
+blank[523 * 1000 + 411] = 200;
+var sampled = Buffer.alloc(10 * 10 * 4), maximum = Buffer.alloc(10 * 10 * 4);
+gifblobber.raw.stretch(blank, 1000, 1000, palette, palette, 0, 1000, 0, 1000, 10, 10, false, sampled, function() {
+  gifblobber.raw.stretch(blank, 1000, 1000, palette, palette, 0, 1000, 0, 1000, 10, 10, false, maximum, function() {
+    assert.equal(sampled.readUInt32LE((5 * 10 + 4) * 4), 6);
+    assert.equal(maximum.readUInt32LE((5 * 10 + 4) * 4), 200);
+    called('hot pixel');
+  }, null, 'max');
+});
+
+// Run-length sources reduce the same
+function checkRunLength() {
+  var bytes = fs.readFileSync('./corpus/radar.gif');
+  gifblobber.decode(bytes, function(error, dense) {
+    assert(!error, error);
+    gifblobber.decode(bytes, { rle: true }, function(error, runs) {
+      assert(!error, error);
+      ['max', 'mean'].forEach(function(reduce) {
+        var expected = Buffer.alloc(64 * 48 * 4), actual = Buffer.alloc(64 * 48 * 4);
+        dense.stretchWith({ reduce: reduce }, 0, dense.width, 0, dense.height, 64, 48, false, expected, function() {
+          runs.stretchWith({ reduce: reduce }, 0, runs.width, 0, runs.height, 64, 48, false, actual, function() {
+            assert(actual.equals(expected), reduce);
+            called('run-length ' + reduce);
+          });
+        });
+      });
+    });
+  });
+}
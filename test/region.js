@@ -0,0 +1,47 @@
+var fs = require('fs');
+var gifblobber = require('../lib/index');
+var assert = require('assert');
+
+var names = ['radar.gif', 'radar_interlaced.gif', 'anim.gif'];
+
+// How many regions of each file were checked, on the way out, so that a
+// decode which never calls back fails rather than passing quietly
+var calls = {};
+process.on('exit', function() {
+  names.forEach(function(name) {
+    assert.equal(calls[name], 4, name + ' checked ' + (calls[name] || 0) + ' regions');
+  });
+});
+
+// Any region must match the same part of a full decode, whether rows are
+// stored in order or interlaced
+names.forEach(function(name) {
+  var bytes = fs.readFileSync('./corpus/' + name);
+  gifblobber.decode(bytes, function(error, full) {
+    assert(!error, error);
+
+    var regions = [
+      { rows: 17 },
+      { left: 10, top: 5, right: 90, bottom: 60 },
+      { left: -5, top: 30, right: full.width + 5, bottom: full.height + 5 },
+      { left: 40, top: 40, right: 40, bottom: 41 }
+    ];
+    regions.forEach(function(region) {
+      gifblobber.decode(bytes, region, function(error, image) {
+        assert(!error, error);
+        var left = Math.max(0, region.left || 0);
+        var top = Math.max(0, region.top || 0);
+        var right = Math.min(full.width, region.right === undefined ? full.width : region.right);
+        var bottom = Math.min(full.height, region.rows === undefined ? region.bottom : region.rows);
+        assert.equal(image.width, right - left, name);
+        assert.equal(image.height, bottom - top, name);
+        for (var y = top; y < bottom; y++) {
+          var expected = full.pixels.slice(y*full.width + left, y*full.width + right);
+          var actual = image.pixels.slice((y - top)*image.width, (y - top + 1)*image.width);
+          assert.deepEqual(actual, expected, name + ' row ' + y);
+        }
+        calls[name] = (calls[name] || 0) + 1;
+      });
+    });
+  });
+});
@@ -0,0 +1,51 @@
+var fs = require('fs');
+var gifblobber = require('../lib/index');
+var assert = require('assert');
+
+var bytes = fs.readFileSync('./corpus/radar.gif');
+
+// Stretching the run-length form must give exactly what the dense one does,
+// zoomed in and out, including views hanging off the edges
+var views = [
+  [0, 320, 0, 240, 160, 120],
+  [-20, 300, 10, 250, 100, 90],
+  [100, 140, 80, 110, 256, 192],
+  [300, 330, 220, 250, 128, 128]
+];
+
+// How many times each comparison ran, checked on the way out so that a
+// stretch which never calls back fails rather than passing quietly
+var calls = {};
+process.on('exit', function() {
+  views.forEach(function(view) {
+    [false, true].forEach(function(filtered) {
+      var label = JSON.stringify(view) + (filtered ? ' filtered' : '');
+      assert.equal(calls[label], 1, label + ' compared ' + (calls[label] || 0) + ' times');
+    });
+  });
+});
+
+gifblobber.decode(bytes, function(error, dense) {
+  assert(!error, error);
+  gifblobber.decode(bytes, { rle: true }, function(error, runs) {
+    assert(!error, error);
+    assert.equal(runs.width, dense.width);
+    assert.equal(runs.height, dense.height);
+    assert.equal(runs.rowStarts.length, (runs.height + 1) * 4);
+
+    views.forEach(function(view) {
+      [false, true].forEach(function(filtered) {
+        var width = view[4], height = view[5];
+        var expected = Buffer.alloc(width * height * 4);
+        var actual = Buffer.alloc(width * height * 4);
+        dense.stretch(view[0], view[1], view[2], view[3], width, height, filtered, expected, function() {
+          runs.stretch(view[0], view[1], view[2], view[3], width, height, filtered, actual, function() {
+            var label = JSON.stringify(view) + (filtered ? ' filtered' : '');
+            calls[label] = (calls[label] || 0) + 1;
+            assert(actual.equals(expected), label);
+          });
+        });
+      });
+    });
+  });
+});
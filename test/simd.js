@@ -0,0 +1,54 @@
+var fs = require('fs');
+var crypto = require('crypto');
+var child_process = require('child_process');
+var gifblobber = require('../lib/index');
+var assert = require('assert');
+
+// Renders a set of views and prints a digest of them all. The vectorized
+// kernels must give exactly what the scalar ones do, so the digest has to
+// match the one from a run with SIMD turned off.
+var views = [
+  [0, 320, 0, 240, 160, 120],
+  [-37.5, 290, 11, 239, 101, 77],
+  [3, 330, -10, 260, 317, 255],
+  [100.25, 1000, 0, 240, 50, 3],
+  [100, 140, 80, 110, 256, 192],
+  [10.3, 30.9, 200.5, 215, 301, 203]
+];
+
+// Each pixel size has kernels of its own
+var formats = [{ name: 'rgba', bytes: 4 }, { name: 'rgb565', bytes: 2 }, { name: 'indexed', bytes: 1 }];
+
+// How many stretches called back, checked on the way out so that one which
+// never does fails rather than leaving the digest unchecked
+var calls = 0;
+process.on('exit', function() {
+  assert.equal(calls, views.length * formats.length * 2, 'stretched ' + calls + ' views');
+});
+
+function render(callback) {
+  gifblobber.decode(fs.readFileSync('./corpus/radar.gif'), function(error, image) {
+    assert(!error, error);
+    var hash = crypto.createHash('sha1');
+    (function next(i) {
+      if (i == views.length * formats.length * 2) return callback(hash.digest('hex'));
+      var view = views[(i >> 1) % views.length], format = formats[Math.floor(i / (views.length * 2))];
+      var dest = Buffer.alloc(view[4] * view[5] * format.bytes);
+      image.stretchWith({ format: format.name }, view[0], view[1], view[2], view[3], view[4], view[5], i & 1, dest, function() {
+        calls++;
+        hash.update(dest);
+        next(i + 1);
+      });
+    })(0);
+  });
+}
+
+if (process.argv[2] == 'digest') {
+  render(function(digest) { console.log(digest); });
+} else {
+  render(function(digest) {
+    var env = Object.assign({}, process.env, { GIFBLOBBER_NO_SIMD: '1' });
+    var scalar = child_process.execFileSync(process.execPath, [__filename, 'digest'], { env: env }).toString().trim();
+    assert.equal(digest, scalar);
+  });
+}
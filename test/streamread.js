@@ -0,0 +1,82 @@
+var fs = require('fs');
+var gifblobber = require('../lib/index');
+var assert = require('assert');
+
+// How many times each decoder's callback ran, checked on the way out so
+// that a decoder which never finishes fails rather than passing quietly
+var calls = {};
+var names = ['fourcolor.gif', 'radar.gif', 'radar_interlaced.gif', 'truncated'];
+process.on('exit', function() {
+  names.forEach(function(name) {
+    assert.equal(calls[name], 1, name + ' called back ' + (calls[name] || 0) + ' times');
+  });
+  assert.equal(calls.crowd, 64, 'crowd called back ' + (calls.crowd || 0) + ' times');
+});
+
+function called(name) {
+  calls[name] = (calls[name] || 0) + 1;
+  if (names.every(function(name) { return calls[name]; })) crowd();
+}
+
+// Once the others are done: past 64 running at once, createDecoder refuses
+// more until some finish
+function crowd() {
+  var decoders = [];
+  assert.throws(function() {
+    for (;;) {
+      decoders.push(gifblobber.createDecoder(function(error) {
+        calls.crowd = (calls.crowd || 0) + 1;
+        assert(error);
+      }));
+    }
+  }, /Too many decoders running at once/);
+  assert.equal(decoders.length, 64);
+  decoders.forEach(function(decoder) { decoder.end(); });
+}
+
+// Decoding as the bytes arrive, chunk by chunk, gives what decode() does
+function streamed(name, bytes, chunkSize) {
+  gifblobber.decode(bytes, function(error, expected) {
+    assert(!error, error);
+
+    var decoder = gifblobber.createDecoder(function(error, image) {
+      assert(!error, error);
+      assert.equal(image.width, expected.width);
+      assert.equal(image.height, expected.height);
+      assert(image.pixels.equals(expected.pixels), name);
+      assert(image.unfiltered_palette.equals(expected.unfiltered_palette), name);
+      assert(image.filtered_palette.equals(expected.filtered_palette), name);
+      assert(image.occupancy.equals(expected.occupancy), name);
+      called(name);
+    });
+
+    var offset = 0;
+    (function next() {
+      if (offset == bytes.length) return decoder.end();
+      var end = Math.min(bytes.length, offset + chunkSize());
+      decoder.push(bytes.slice(offset, end));
+      offset = end;
+      setImmediate(next);
+    })();
+  });
+}
+
+// One byte at a time, as if from a very slow link
+var fourcolor = fs.readFileSync('./fourcolor.gif');
+streamed('fourcolor.gif', fourcolor, function() { return 1; });
+
+// Chunks of random sizes, so that they split the header, the palette, and
+// sub-blocks anywhere. A fixed seed keeps failures repeatable.
+var seed = 12345;
+function randomChunk() {
+  seed = (seed * 1103515245 + 12345) & 0x7fffffff;
+  return 1 + seed % 700;
+}
+streamed('radar.gif', fs.readFileSync('./corpus/radar.gif'), randomChunk);
+streamed('radar_interlaced.gif', fs.readFileSync('./corpus/radar_interlaced.gif'), randomChunk);
+
+var truncated = gifblobber.createDecoder(function(error, image) {
+  assert(error);
+  called('truncated');
+});
+truncated.end(fourcolor.slice(0, 10));